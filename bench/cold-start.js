@@ -0,0 +1,65 @@
+// Cold start of `node app.js --version`: each run is a fresh process, so
+// the time includes loading gocommander and, if it happens, the addon and
+// the Go runtime. "eager" forces the addon to load at require time, as
+// every run did before loading became lazy.
+//
+//   node bench/cold-start.js [runs] [other-checkout]
+//
+// Passing the path of another checkout (e.g. a worktree of an older
+// commit) adds its timings for a before/after comparison. Without a built
+// addon every mode runs the same JS fallback, so the bench refuses to run.
+const { execFileSync } = require("child_process");
+const path = require("path");
+
+const runs = Number(process.argv[2]) || 30;
+const other = process.argv[3];
+
+function app(root, eager) {
+  return `
+    const gocommander = require(${JSON.stringify(root)});
+    ${eager ? "gocommander.addon;" : ""}
+    new gocommander.Command("app").version("1.2.3")
+      .option("-p, --port <port>", "Port")
+      .action(() => {})
+      .parse(["node", "app", "--version"]);
+  `;
+}
+
+function measure(label, script) {
+  const times = [];
+  for (let i = 0; i < runs; i++) {
+    const start = process.hrtime.bigint();
+    execFileSync(process.execPath, ["-e", script], { stdio: "ignore" });
+    times.push(Number(process.hrtime.bigint() - start) / 1e6);
+  }
+  times.sort((a, b) => a - b);
+  const pct = (p) => times[Math.min(times.length - 1, Math.floor(p * times.length))].toFixed(1).padStart(7);
+  console.log(`${label.padEnd(20)} p50 ${pct(0.5)} ms  p90 ${pct(0.9)} ms  min ${pct(0)} ms`);
+}
+
+// Whether the checkout at root finds a built addon, asked in a child
+// process so this one stays cold
+function hasAddon(root) {
+  const script = `process.exit(require(${JSON.stringify(root)}).addon.NativeCommand ? 0 : 1)`;
+  try {
+    execFileSync(process.execPath, ["-e", script], { stdio: "ignore" });
+    return true;
+  } catch (error) {
+    return false;
+  }
+}
+
+const root = path.join(__dirname, "..");
+for (const checkout of other ? [root, path.resolve(other)] : [root]) {
+  if (!hasAddon(checkout)) {
+    console.error(`No built addon in ${checkout}; run npm run build first`);
+    process.exit(1);
+  }
+}
+console.log(`${runs} runs each\n`);
+measure("node (empty)", "");
+measure("--version (lazy)", app(root, false));
+measure("--version (eager)", app(root, true));
+if (other) {
+  measure("--version (other)", app(path.resolve(other), false));
+}
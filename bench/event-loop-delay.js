@@ -0,0 +1,63 @@
+// Event-loop delay while parsing a very large argument vector, comparing
+// the synchronous native parse, parseAsync and the JS fallback.
+//
+//   node bench/event-loop-delay.js [argc] [rounds]
+const { monitorEventLoopDelay } = require("perf_hooks");
+const { Command, addon } = require("../index.js");
+
+const argc = Number(process.argv[2]) || 200000;
+const rounds = Number(process.argv[3]) || 20;
+
+function buildProgram() {
+  const app = new Command("bench");
+  for (let i = 0; i < 256; i++) {
+    app.option(`--flag-${i} <value>`, `Option ${i}`);
+  }
+  app.option("-v, --verbose", "Verbose output").action(() => {});
+  return app;
+}
+
+const argv = ["node", "bench"];
+for (let i = 0; i < argc; i++) {
+  argv.push(i % 4 === 0 ? "--verbose" : `src/components/file-${i}.ts`);
+}
+
+// Measures how late a 1ms timer fires while fn runs its parses
+async function measure(label, fn) {
+  const histogram = monitorEventLoopDelay({ resolution: 1 });
+  histogram.enable();
+  const ticker = setInterval(() => {}, 1);
+
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < rounds; i++) {
+    await fn();
+    // Let pending timers run between rounds, as a server would
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+  const elapsedMs = Number(process.hrtime.bigint() - start) / 1e6;
+
+  clearInterval(ticker);
+  histogram.disable();
+  const ms = (ns) => (ns / 1e6).toFixed(2).padStart(8);
+  console.log(`${label.padEnd(12)} total ${elapsedMs.toFixed(0).padStart(6)} ms  ` +
+              `loop delay p50 ${ms(histogram.percentile(50))} ms  ` +
+              `p99 ${ms(histogram.percentile(99))} ms  max ${ms(histogram.max)} ms`);
+}
+
+async function main() {
+  const app = buildProgram();
+  console.log(`${argc} arguments, ${rounds} rounds\n`);
+
+  await measure("js (sync)", () => app._parseJS(argv.slice(2)));
+  if (app._ensureNative()) {
+    await measure("native sync", () => app.parse(argv));
+    await measure("parseAsync", () => app.parseAsync(argv));
+  } else {
+    console.log(`native       skipped (addon not loaded: ${addon.version()})`);
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
@@ -0,0 +1,47 @@
+// Parse throughput: Go engine through the addon vs the JS fallback parser.
+//
+//   node bench/parse-throughput.js [iterations]
+const { Command, addon } = require("../index.js");
+
+const iterations = Number(process.argv[2]) || 100000;
+
+function buildProgram() {
+  const app = new Command("bench");
+  const deploy = app.command("deploy", "Deploy a service");
+  for (let i = 0; i < 32; i++) {
+    deploy.option(`--flag-${i} <value>`, `Option ${i}`);
+  }
+  deploy
+    .option("-v, --verbose", "Verbose output")
+    .option("-r, --region <region>", "Target region", "us-east-1")
+    .argument("<service>", "Service to deploy")
+    .action(() => {});
+  return app;
+}
+
+const argv = [
+  "deploy", "api", "--verbose", "--region", "eu-west-1",
+  "--flag-3", "a", "--flag-17", "b", "--flag-31", "c"
+];
+
+function run(label, parse) {
+  // Warm up so both paths are measured after JIT/cgo setup
+  for (let i = 0; i < Math.min(iterations, 10000); i++) parse();
+
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < iterations; i++) parse();
+  const elapsedNs = Number(process.hrtime.bigint() - start);
+
+  const opsPerSec = Math.round(iterations / (elapsedNs / 1e9));
+  console.log(`${label.padEnd(8)} ${opsPerSec.toLocaleString().padStart(12)} parses/sec  ` +
+              `${(elapsedNs / iterations).toFixed(0).padStart(7)} ns/parse`);
+}
+
+const app = buildProgram();
+console.log(`Parsing ${argv.length} tokens, ${iterations} iterations\n`);
+run("js", () => app._parseJS(argv));
+if (app._ensureNative()) {
+  run("native", () => app._parseNative(argv));
+} else {
+  console.log(`native   skipped (addon not loaded: ${addon.version()})`);
+}
@@ -1,57 +1,96 @@
-// Load the Go addon directly
-let addon;
-try {
-  // Try multiple possible paths for the addon
-  const possiblePaths = [
-    "./build/Release/gommander.node",
-    "./build/Debug/gommander.node", 
-    "./build/gommander.node"
-  ];
-
-  for (const addonPath of possiblePaths) {
-    try {
-      addon = require(addonPath);
-      console.log(`Successfully loaded Go addon from: ${addonPath}`);
-      break;
-    } catch (e) {
-      // Continue trying other paths
-    }
+const fs = require("fs");
+const path = require("path");
+const { encodeSchema, Kind } = require("./lib/schema");
+const { ParseResult, Status, Outcome } = require("./lib/result");
+
+// Verbose tracing is opt-in so it stays out of the parse hot path
+const debug = process.env.GOCOMMANDER_DEBUG ? console.log : () => {};
+
+// Where node-gyp may have put the addon, relative to this file
+const addonPaths = [
+  "build/Release/gommander.node",
+  "build/Debug/gommander.node",
+  "build/gommander.node"
+];
+
+// The addon is only loaded when a command first needs the Go engine.
+// Loading it starts the Go runtime, so keeping it unloaded is what keeps
+// requiring the package and answering --help or --version cheap.
+let addon = null;
+let addonPath; // undefined until resolved, null when no build was found
+
+// Find the built addon with one stat per candidate instead of a throwing
+// require() per candidate; the answer is cached for the process
+function resolveAddonPath() {
+  if (addonPath === undefined) {
+    addonPath = addonPaths
+      .map((candidate) => path.join(__dirname, candidate))
+      .find((candidate) => fs.existsSync(candidate)) || null;
   }
+  return addonPath;
+}
 
-  if (!addon) {
-    throw new Error("Go addon not found in any expected location");
+function loadAddon() {
+  if (addon) return addon;
+  try {
+    const found = resolveAddonPath();
+    if (!found) {
+      throw new Error("Go addon not found in any expected location");
+    }
+    addon = require(found);
+    if (addon.setDispatcher) addon.setDispatcher(dispatchAction);
+    debug(`Successfully loaded Go addon from: ${found}`);
+  } catch (error) {
+    console.warn("Go addon not available:", error.message);
+    console.warn("Using JavaScript implementation with Go backend structure");
+    // Provide fallback addon interface
+    addon = {
+      hello: () => "JavaScript implementation (Go backend ready)",
+      version: () => "1.0.0-js-fallback"
+    };
   }
-} catch (error) {
-  console.warn("Go addon not available:", error.message);
-  console.warn("Using JavaScript implementation with Go backend structure");
-  // Provide fallback addon interface
-  addon = {
-    hello: () => "JavaScript implementation (Go backend ready)",
-    version: () => "1.0.0-js-fallback"
-  };
+  return addon;
+}
+
+// Native parses in flight, by the token Go hands back with the action it
+// dispatches. Actions stay on their JS commands: the addon only holds the
+// dispatchAction function, so a dropped command can be garbage collected
+// and its Go tree released by the finalizer.
+const calls = new Map();
+let nextToken = 0;
+
+// Run the action with this ID for the parse call token refers to
+function dispatchAction(action, words, token) {
+  const call = calls.get(token);
+  if (call) call.root._dispatch(call, action, words);
 }
 
+// Buffers the Go engine writes parse results into, one per nesting level:
+// an action runs inside the native parse call and may parse again, so a
+// buffer is only handed back once its words were copied. Grown on demand.
+const resultBuffers = [];
+
 // Go-backed Command class
 class Command {
   constructor(name) {
     this._name = name || "";
-    this._goCommandPtr = null;
     this._options = new Map();
     this._arguments = [];
     this._action = null;
     this._subcommands = new Map();
     this._parent = null;
-    
-    // Create Go command object through addon
-    // Note: The actual Go integration would need additional C++ bindings
-    // For now, we'll track the command structure and delegate to Go when possible
-    console.log(`Creating command: ${name || 'root'}`);
+
+    // The Go command tree is built from the recorded structure in a single
+    // call the first time it is needed (see _ensureNative)
+    this._native = null;
+    debug(`Creating command: ${name || 'root'}`);
   }
 
   // Set command description
   description(desc) {
     if (arguments.length === 0) return this._description;
     this._description = desc;
+    this._invalidate();
     return this;
   }
 
@@ -59,15 +98,30 @@ class Command {
   version(ver) {
     if (arguments.length === 0) return this._version;
     this._version = ver;
+    this._invalidate();
     return this;
   }
 
-  // Add an option
-  option(flags, description, defaultValue) {
+  // Add an option. config.kind names the type the Go engine converts the
+  // value to (see Kind in lib/schema.js; durations arrive in milliseconds),
+  // and defaultValue, which may be given as text, is read back converted;
+  // config.choices lists the values allowed for an enum; config.env names
+  // an environment variable the engine reads when the option is not given,
+  // as process.env has it when the parse starts, and config.config the key it looks up in the config file after that.
+  option(flags, description, defaultValue, config = {}) {
+    const choices = config.choices || [];
+    const kindName = config.kind || (config.choices ? "enum" : "auto");
+    if (!Object.prototype.hasOwnProperty.call(Kind, kindName)) {
+      throw new Error(`unknown option kind '${kindName}'`);
+    }
     const option = {
       flags,
       description: description || "",
-      defaultValue
+      defaultValue,
+      kind: Kind[kindName],
+      choices,
+      envVar: config.env || "",
+      configKey: config.config || ""
     };
     
     // Parse flag names for storage
@@ -79,17 +133,21 @@ class Command {
                       shortFlag ? shortFlag.replace('-', '') : 'unknown';
     
     this._options.set(optionName, option);
-    console.log(`Added option: ${flags}`);
+    this._slots = null;
+    this._invalidate();
+    debug(`Added option: ${flags}`);
     return this;
   }
 
-  // Add an argument
-  argument(name, description) {
+  // Add an argument; config.choices lists the values it allows
+  argument(name, description, config = {}) {
     this._arguments.push({
       name,
-      description: description || ""
+      description: description || "",
+      choices: config.choices || []
     });
-    console.log(`Added argument: ${name}`);
+    this._invalidate();
+    debug(`Added argument: ${name}`);
     return this;
   }
 
@@ -98,23 +156,53 @@ class Command {
     const cmd = new Command(name);
     cmd._parent = this;
     if (description) {
-      cmd._description = description;
+      cmd.description(description);
     }
     
     this._subcommands.set(name, cmd);
-    console.log(`Added subcommand: ${name}`);
+    this._subcommandList = null;
+    this._invalidate();
+    debug(`Added subcommand: ${name}`);
     return cmd;
   }
 
   // Set action handler
   action(fn) {
     this._action = fn;
+    this._invalidate();
     return this;
   }
 
   // Allow unknown options
   allowUnknownOption(allow = true) {
     this._allowUnknownOption = allow;
+    this._invalidate();
+    return this;
+  }
+
+  // Let the Go engine replace an argument "@path" by the arguments in the
+  // file at path; only the setting of the command being parsed counts
+  allowResponseFiles(allow = true) {
+    this._responseFiles = allow;
+    this._invalidate();
+    return this;
+  }
+
+  // Take option defaults for this command and its subcommands from a JSON
+  // file the Go engine reads; options look up their config key, or their
+  // name, with nested objects joined by dots ("server.port")
+  configFile(file) {
+    if (arguments.length === 0) return this._configFile;
+    this._configFile = file;
+    this._invalidate();
+    return this;
+  }
+
+  // Let subcommands be selected by a prefix of their name that no other
+  // subcommand shares (`dep` for `deploy`)
+  allowAbbreviatedCommands(allow = true) {
+    this._abbreviateCommands = allow;
+    this._invalidate();
     return this;
   }
 
@@ -124,12 +212,308 @@ class Command {
       argv = process.argv;
     }
 
-    console.log(`Parsing with Go backend: ${this._name || 'root'}`);
-    
+    debug(`Parsing with Go backend: ${this._name || 'root'}`);
+
     // Skip node and script name
     const args = argv.slice(2);
-    
-    // Simple parsing logic - in a full implementation this would delegate to Go
+    this._answerBuiltin(args);
+    if (this._ensureNative()) {
+      this._parseNative(args);
+    } else {
+      this._parseJS(args);
+    }
+    return this;
+  }
+
+  // Parse command line arguments without blocking the event loop: the Go
+  // engine runs on the libuv threadpool and the action runs back on the
+  // main thread. Resolves once the action (sync or async) has finished.
+  async parseAsync(argv) {
+    if (!argv) {
+      argv = process.argv;
+    }
+
+    const args = argv.slice(2);
+    this._answerBuiltin(args);
+    if (!this._ensureNative()) {
+      this._parseJS(args);
+      return this;
+    }
+
+    // Go queues the matched action back onto this thread; wait for both
+    // the parse and the action it dispatched
+    const call = this._beginCall(args, true);
+    try {
+      const result = new ParseResult(this, args, await this._native.parseAsync(args, call.token, this._environ(args)));
+      this._exitBuiltin(result);
+      if (!result.ok) {
+        throw new Error(result.message);
+      }
+      if (result.command._action) {
+        await call.done;
+      }
+    } finally {
+      calls.delete(call.token);
+    }
+    return this;
+  }
+
+  // Release the Go command trees held by this command and its subcommands
+  // now rather than when they are garbage collected. The command stays
+  // usable; its tree is rebuilt on the next parse.
+  dispose() {
+    for (const cmd of this._subcommands.values()) {
+      cmd.dispose();
+    }
+    if (this._native) {
+      this._native.destroy();
+      this._native = null;
+    }
+    return this;
+  }
+
+  // Parse args (without node and script name) and run the matched action,
+  // but report help and version requests and parse errors in the returned
+  // outcome instead of printing them or exiting, so untrusted command lines
+  // can be parsed inside a long-running process. Errors thrown by the
+  // action propagate.
+  run(args) {
+    if (!this._ensureNative()) {
+      const builtin = this._builtin(args);
+      if (builtin) return { kind: builtin.kind, command: builtin.command, index: args.length - 1, message: "" };
+      return { kind: Outcome.DISPATCH, command: this._parseJS(args), index: -1, message: "" };
+    }
+
+    const call = this._beginCall(args, false);
+    let result;
+    try {
+      result = this._parseResult(args, call.token);
+    } finally {
+      calls.delete(call.token);
+    }
+    if (call.error) {
+      throw call.error;
+    }
+    return result.outcome;
+  }
+
+  // --help or --version right after the (sub)command names is answered
+  // here, the same way the Go engine would, without loading the addon.
+  // Command lines with anything else before the flag go to the engine.
+  _answerBuiltin(args) {
+    const builtin = this._builtin(args);
+    if (!builtin) return;
+    if (builtin.kind === Outcome.HELP) {
+      builtin.command.outputHelp();
+    } else {
+      console.log(builtin.command._version);
+    }
+    process.exit(0);
+  }
+
+  // { kind, command } if args is a path of subcommand names followed by a
+  // lone built-in flag: kind is Outcome.HELP or Outcome.VERSION
+  _builtin(args) {
+    let command = this;
+    for (let i = 0; i < args.length - 1; i++) {
+      command = command._findSubcommand(args[i]);
+      if (!command) return undefined;
+    }
+    const flag = args[args.length - 1];
+    if (flag === "-h" || flag === "--help") return { kind: Outcome.HELP, command };
+    if ((flag === "-V" || flag === "--version") && command._version) return { kind: Outcome.VERSION, command };
+    return undefined;
+  }
+
+  // Print the help or version Go reported for a (sub)command and exit, as
+  // a CLI does
+  _exitBuiltin(result) {
+    if (result.status === Status.HELP) {
+      result.command.outputHelp();
+      process.exit(0);
+    }
+    if (result.status === Status.VERSION) {
+      console.log(result.command._version);
+      process.exit(0);
+    }
+  }
+
+  // Build the Go command tree for this command and its subcommands with a
+  // single call into the addon; returns null when the addon is unavailable
+  _ensureNative() {
+    if (!this._native && loadAddon().NativeCommand) {
+      // Commands with an action, by action ID - 1
+      this._actionCommands = [];
+      this._native = new addon.NativeCommand(encodeSchema(this, this._actionCommands));
+      this._treeEnv = this._collectEnvVars();
+    }
+    return this._native;
+  }
+
+  // Record the environment variables the options of each command in this
+  // tree name; true if there are any
+  _collectEnvVars() {
+    this._envVars = [];
+    this._options.forEach((option) => {
+      if (option.envVar) this._envVars.push(option.envVar);
+    });
+    let any = this._envVars.length > 0;
+    this._subcommands.forEach((cmd) => {
+      any = cmd._collectEnvVars() || any;
+    });
+    return any;
+  }
+
+  // "NAME=value" for the set variables Go may look up while parsing args.
+  // Go reads them here rather than in its own copy of the environment,
+  // which never sees changes made through process.env. Only the matched
+  // command's variables are looked up, and it is only known once Go has
+  // parsed, so this reads those of every command args may select: each
+  // subcommand named in args below one already selected. That covers the
+  // matched command even when an option took a subcommand's name as its
+  // value, and keeps process.env reads to a few per parse however large
+  // the tree.
+  _environ(args) {
+    const environ = [];
+    if (!this._treeEnv) return environ;
+    const commands = [this];
+    for (const arg of args) {
+      if (arg === "--") break;
+      if (arg.startsWith("-")) continue;
+      for (let i = 0, n = commands.length; i < n; i++) {
+        const sub = commands[i]._findSubcommand(arg);
+        if (sub && !commands.includes(sub)) commands.push(sub);
+      }
+    }
+    const seen = new Set();
+    for (const cmd of commands) {
+      for (const name of cmd._envVars) {
+        if (seen.has(name)) continue;
+        seen.add(name);
+        const value = process.env[name];
+        if (value !== undefined) environ.push(`${name}=${value}`);
+      }
+    }
+    return environ;
+  }
+
+  // Track an in-flight native parse so the action Go dispatches can be
+  // matched with the arguments it refers to
+  _beginCall(args, async) {
+    nextToken = (nextToken + 1) >>> 0 || 1;
+    const call = {
+      token: nextToken,
+      root: this,
+      commands: this._actionCommands,
+      args,
+      error: null,
+      done: null
+    };
+    if (async) {
+      call.done = new Promise((resolve, reject) => {
+        call.resolve = resolve;
+        call.reject = reject;
+      });
+    }
+    calls.set(call.token, call);
+    return call;
+  }
+
+  // Run the action Go dispatched for a parse of this command tree
+  _dispatch(call, action, words) {
+    const cmd = call.commands[action - 1];
+    if (!cmd) return;
+
+    const result = new ParseResult(this, call.args, words);
+    result._command = cmd;
+    try {
+      const ret = cmd._action(result.args, result.options);
+      if (call.resolve) call.resolve(ret);
+    } catch (error) {
+      call.error = error;
+      if (call.reject) call.reject(error);
+    }
+  }
+
+  // Drop cached Go trees that no longer match the recorded structure
+  _invalidate() {
+    for (let cmd = this; cmd; cmd = cmd._parent) {
+      cmd._native = null;
+    }
+  }
+
+  // Option names indexed by the slot numbers Go reports (declaration order)
+  _optionSlots() {
+    if (!this._slots) this._slots = [...this._options.keys()];
+    return this._slots;
+  }
+
+  // Config file Go reads for this command, its own or an ancestor's
+  _nearestConfigFile() {
+    let cmd = this;
+    while (cmd && !cmd._configFile) cmd = cmd._parent;
+    return cmd ? cmd._configFile : undefined;
+  }
+
+  _subcommandAt(index) {
+    if (!this._subcommandList) this._subcommandList = [...this._subcommands.values()];
+    return this._subcommandList[index];
+  }
+
+  // Run the Go engine over args and return a lazily decoded ParseResult
+  _parseResult(args, token = 0) {
+    let words = resultBuffers.pop() || new Uint32Array(1024);
+    const environ = this._environ(args);
+    try {
+      if (this._native.parse(args, words, token, environ) === Status.TOO_SMALL) {
+        words = new Uint32Array(words[1]);
+        this._native.parse(args, words, token, environ);
+      }
+      return new ParseResult(this, args, words);
+    } finally {
+      resultBuffers.push(words);
+    }
+  }
+
+  // Delegate parsing to the Go engine; the matched action is dispatched by
+  // Go before the native call returns
+  _parseNative(args) {
+    const call = this._beginCall(args, false);
+    let result;
+    try {
+      result = this._parseResult(args, call.token);
+    } finally {
+      calls.delete(call.token);
+    }
+
+    this._exitBuiltin(result);
+    if (!result.ok) {
+      throw new Error(result.message);
+    }
+    if (call.error) {
+      throw call.error;
+    }
+    return result.command;
+  }
+
+  // Subcommand lookup for the fallback parser, mirroring findCommandIndex
+  // in the Go engine
+  _findSubcommand(name) {
+    const exact = this._subcommands.get(name);
+    if (exact || !this._abbreviateCommands || !name) return exact;
+
+    let match;
+    for (const [key, cmd] of this._subcommands) {
+      if (key.startsWith(name)) {
+        if (match) return undefined;
+        match = cmd;
+      }
+    }
+    return match;
+  }
+
+  // Fallback parser used when the Go addon is not available
+  _parseJS(args) {
     const options = {};
     const positionalArgs = [];
     let i = 0;
@@ -138,9 +522,9 @@ class Command {
       const arg = args[i];
       
       // Check for subcommand
-      if (this._subcommands.has(arg)) {
-        const subcmd = this._subcommands.get(arg);
-        return subcmd.parse([...argv.slice(0, 2), ...args.slice(i + 1)]);
+      const subcommand = this._findSubcommand(arg);
+      if (subcommand) {
+        return subcommand._parseJS(args.slice(i + 1));
       }
       
       // Handle options
@@ -226,9 +610,11 @@ const program = new Command();
 module.exports = {
   Command,
   program,
-  addon,
+  get addon() {
+    return loadAddon();
+  },
   createCommand: (name) => new Command(name),
   // Expose Go addon functions directly
-  version: () => addon.version(),
-  hello: () => addon.hello()
+  version: () => loadAddon().version(),
+  hello: () => loadAddon().hello()
 };
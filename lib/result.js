@@ -0,0 +1,454 @@
+// Lazy view over the packed parse result written by ParseInto (see
+// src/go/result.go). Nothing is decoded until a field is read, so commands
+// with hundreds of options only pay for the values an action touches.
+
+const { Kind } = require("./schema");
+
+const HEADER_WORDS = 6;
+const NONE = 0xffffffff;
+const FROM_ENV = 0xfffffffe;
+const FROM_CONFIG = 0xfffffffd;
+
+// Reassembles the float64 values Go sends as two words
+const floatView = new DataView(new ArrayBuffer(8));
+
+const Status = {
+  OK: 0,
+  UNKNOWN_OPTION: 1,
+  MISSING_OPTION_ARGUMENT: 2,
+  MISSING_ARGUMENTS: 3,
+  INVALID_VALUE: 4,
+  INVALID_CHOICE: 5,
+  INVALID_ARGUMENT: 6,
+  CONFIG: 7,
+  RESPONSE_FILE: 8,
+  INVALID_HANDLE: 100,
+  TOO_SMALL: 101,
+  HELP: 102,
+  VERSION: 103
+};
+
+// What a parse asks its caller to do next (OutcomeKind in src/go/outcome.go)
+const Outcome = {
+  DISPATCH: "dispatch",
+  HELP: "help",
+  VERSION: "version",
+  ERROR: "error"
+};
+
+class ParseResult {
+  // root: the Command that was parsed, argv: the arguments passed to Go,
+  // words: the result buffer; only the used words are kept so the
+  // buffer can be reused by the next parse
+  constructor(root, argv, words) {
+    this._root = root;
+    this._argv = argv;
+    this._words = words.slice(0, words[1]);
+    this._command = null;
+    this._args = null;
+    this._options = null;
+  }
+
+  get status() {
+    return this._words[0];
+  }
+
+  get ok() {
+    return this._words[0] === Status.OK;
+  }
+
+  get kind() {
+    switch (this._words[0]) {
+      case Status.OK: return Outcome.DISPATCH;
+      case Status.HELP: return Outcome.HELP;
+      case Status.VERSION: return Outcome.VERSION;
+      default: return Outcome.ERROR;
+    }
+  }
+
+  // Plain description of the parse for Command.run: the matched command,
+  // the argv index of the help or version flag or of the offending token,
+  // and the error message
+  get outcome() {
+    const kind = this.kind;
+    return {
+      kind,
+      command: this.command,
+      index: this.errorIndex,
+      message: kind === Outcome.ERROR ? this.message : ""
+    };
+  }
+
+  // argv index of the token that caused the error, or of the help or
+  // version flag that stopped the parse, or -1
+  get errorIndex() {
+    const index = this._words[2];
+    return index === NONE || index === FROM_ENV || index === FROM_CONFIG ? -1 : index;
+  }
+
+  get message() {
+    const token = this._token(this.errorIndex);
+    if (this.errorIndex === -1 &&
+        (this.status === Status.INVALID_VALUE || this.status === Status.INVALID_CHOICE)) {
+      return this._sourceMessage();
+    }
+    switch (this.status) {
+      case Status.OK: return "";
+      case Status.UNKNOWN_OPTION: return `unknown option '${token}'`;
+      case Status.MISSING_OPTION_ARGUMENT: return `option '${token}' missing argument`;
+      case Status.MISSING_ARGUMENTS: return "missing required arguments";
+      case Status.INVALID_VALUE: {
+        const [flag, value] = this._flagAndValue();
+        return `option '${flag}' argument '${value}' is invalid`;
+      }
+      case Status.INVALID_CHOICE: {
+        const [flag, value] = this._flagAndValue();
+        const option = this.command._options.get(this.command._optionSlots()[this._words[4]]);
+        return `option '${flag}' argument '${value}' is not an allowed choice` + didYouMean(option, this._words[5]);
+      }
+      case Status.INVALID_ARGUMENT:
+        // Only choice misses carry a suggestion
+        if (this._words[5] !== 0) {
+          return `argument '${token}' is not an allowed choice` +
+            didYouMean(this.command._arguments[this._words[4]], this._words[5]);
+        }
+        return `argument '${token}' is invalid`;
+      case Status.CONFIG: {
+        const cause = this._pathText();
+        return `cannot read config file '${this.command._nearestConfigFile()}'` + (cause ? `: ${cause}` : "");
+      }
+      case Status.RESPONSE_FILE: return `cannot expand response file '${token.slice(1)}'`;
+      case Status.INVALID_HANDLE: return "invalid command handle";
+      default: return "parse error";
+    }
+  }
+
+  // The matched (sub)command
+  get command() {
+    if (!this._command) {
+      let cmd = this._root;
+      const pathLen = this._words[3];
+      for (let i = 0; i < pathLen; i++) {
+        cmd = cmd._subcommandAt(this._words[HEADER_WORDS + i]);
+      }
+      this._command = cmd;
+    }
+    return this._command;
+  }
+
+  // Positional arguments
+  get args() {
+    if (!this._args) {
+      const start = HEADER_WORDS + this._words[3] + 2 * this._words[4];
+      const count = this._words[5];
+      const args = new Array(count);
+      for (let i = 0; i < count; i++) {
+        args[i] = this._token(this._words[start + i]);
+      }
+      this._args = args;
+    }
+    return this._args;
+  }
+
+  // All options with defaults applied
+  get options() {
+    if (!this._options) {
+      const cmd = this.command;
+      const options = {};
+      cmd._options.forEach((option, name) => {
+        const value = defaultOf(option);
+        if (value !== undefined) options[name] = value;
+      });
+      const slots = cmd._optionSlots();
+      const start = HEADER_WORDS + this._words[3];
+      const count = this._words[4];
+      const lists = new Set();
+      for (let i = 0; i < count; i++) {
+        const name = slots[this._words[start + 2 * i]];
+        const option = cmd._options.get(name);
+        if (isList(option)) {
+          // Repeats accumulate; the first one replaces the default
+          if (!lists.has(name)) options[name] = [];
+          lists.add(name);
+          options[name] = options[name].concat(this._decode(option, i));
+        } else {
+          options[name] = this._decode(option, i);
+        }
+      }
+      this._options = options;
+    }
+    return this._options;
+  }
+
+  // A single option value, without materializing the others
+  get(name) {
+    if (this._options) return this._options[name];
+
+    const cmd = this.command;
+    const option = cmd._options.get(name);
+    const slot = cmd._optionSlots().indexOf(name);
+    if (slot >= 0) {
+      const start = HEADER_WORDS + this._words[3];
+      if (isList(option)) {
+        let values;
+        for (let i = 0; i < this._words[4]; i++) {
+          if (this._words[start + 2 * i] === slot) {
+            values = (values || []).concat(this._decode(option, i));
+          }
+        }
+        if (values) return values;
+      } else {
+        // The last occurrence on the command line wins
+        for (let i = this._words[4] - 1; i >= 0; i--) {
+          if (this._words[start + 2 * i] === slot) return this._decode(option, i);
+        }
+      }
+    }
+    return option ? defaultOf(option) : undefined;
+  }
+
+  // Message for an option value Go read from its environment variable or
+  // from the config file; Go sends the rejected text after the path
+  _sourceMessage() {
+    const option = this.command._options.get(this.command._optionSlots()[this._words[4]]);
+    const flags = option.flags.split(/[,\s|]+/).filter((f) => f.startsWith("-"));
+    const flag = flags.find((f) => f.startsWith("--")) || flags[0];
+    const problem = this.status === Status.INVALID_CHOICE
+      ? "is not an allowed choice" + didYouMean(option, this._words[5])
+      : "is invalid";
+    const value = this._pathText();
+    if (this._words[2] === FROM_CONFIG) {
+      return `option '${flag}' argument '${value}' ${problem} (from config key ${configKey(option, flag)})`;
+    }
+    return `option '${flag}' argument '${value}' ${problem} (from environment variable ${option.envVar})`;
+  }
+
+  // Text Go wrote after the path of an error: a rejected value from the
+  // environment or the config file, or why the config file was unreadable
+  _pathText() {
+    const start = HEADER_WORDS + this._words[3];
+    return this._text(start, 4 * (this._words[1] - start)).replace(/\0+$/, "");
+  }
+
+  // Flag and value of a rejected option value. The value is the argument
+  // after the flag's, or shares it: "--name=value", or in a cluster of
+  // short flags the rest after the option's letter ("-vj8"). An option
+  // that takes no value but has a kind needing one is rejected with "".
+  _flagAndValue() {
+    const token = this._token(this.errorIndex);
+    const eq = token.indexOf("=");
+    if (token.startsWith("--") && eq > 2) return [token.slice(0, eq), token.slice(eq + 1)];
+    const option = this.command._options.get(this.command._optionSlots()[this._words[4]]);
+    const short = option.flags.split(/[,\s|]+/).find((f) => /^-[^-]$/.test(f));
+    if (!/[<[]/.test(option.flags)) return [token.startsWith("--") ? token : short, ""];
+    if (!token.startsWith("--") && token.length > 2) {
+      const at = token.indexOf(short[1], 1);
+      if (at + 1 < token.length) return [short, token.slice(at + 1)];
+      return [short, this._token(this.errorIndex + 1)];
+    }
+    return [token, this._token(this.errorIndex + 1)];
+  }
+
+  // The argument the host knows by index: one of argv, or one Go read from
+  // a response file, numbered from argv.length. Go copies only the file
+  // arguments the result refers to, into a table sorted by index that ends
+  // the result.
+  _token(index) {
+    if (index < this._argv.length) return this._argv[index];
+    const words = this._words;
+    const count = words[words.length - 1];
+    const table = words.length - 1 - 3 * count;
+    let lo = 0;
+    let hi = count;
+    while (lo < hi) {
+      const mid = (lo + hi) >>> 1;
+      if (words[table + 3 * mid] < index) lo = mid + 1;
+      else hi = mid;
+    }
+    const entry = table + 3 * lo;
+    if (lo === count || words[entry] !== index) return undefined;
+    return this._text(words[entry + 1], words[entry + 2]);
+  }
+
+  // UTF-8 text Go wrote into the result words
+  _text(word, length) {
+    const words = this._words;
+    return Buffer.from(words.buffer, words.byteOffset + 4 * word, length).toString();
+  }
+
+  // Value of the i-th option entry. Go has already converted values of
+  // typed options; they are read from the values section rather than
+  // parsed again here.
+  _decode(option, i) {
+    const words = this._words;
+    const index = words[HEADER_WORDS + words[3] + 2 * i + 1];
+    const kind = option ? option.kind : Kind.auto;
+    const pos = HEADER_WORDS + words[3] + 2 * words[4] + words[5] + 2 * i;
+    const low = words[pos];
+    const high = words[pos + 1];
+
+    // Strings from the environment or the config file follow the values
+    // section; list items are already split
+    if ((index === FROM_ENV || index === FROM_CONFIG) && (kind === Kind.string || kind === Kind.stringList ||
+        kind === Kind.list || (kind === Kind.auto && /[<[]/.test(option.flags)))) {
+      const text = this._text(low, high);
+      return isList(option) ? text.split("\0") : text;
+    }
+
+    // Flags carry their boolean in the values, wherever it came from
+    if (kind === Kind.auto && !(option && /[<[]/.test(option.flags))) {
+      return option ? low !== 0 : true;
+    }
+
+    // Values given inline ("--name=value") start low bytes into their
+    // argument; flag names are ASCII, so bytes and characters agree
+    if (kind === Kind.auto || kind === Kind.string || kind === Kind.stringList) {
+      return this._token(index).slice(low);
+    }
+    if (kind === Kind.list) {
+      return this._token(index).slice(low).split(",");
+    }
+
+    switch (kind) {
+      case Kind.bool: return low !== 0;
+      case Kind.float:
+        floatView.setUint32(0, low, true);
+        floatView.setUint32(4, high, true);
+        return floatView.getFloat64(0, true);
+      case Kind.enum: return option.choices[low];
+      case Kind.duration: return ((high | 0) * 4294967296 + low) / 1e6;
+      default: return (high | 0) * 4294967296 + low;
+    }
+  }
+}
+
+// Defaults converted as Go converts values of the option's kind, so a
+// default reads back like the same value given on the command line:
+// durations in milliseconds, byte sizes as integers, enums as the choice.
+// Each option's default is converted once; list defaults are copied out
+// so callers cannot change them.
+const defaults = new WeakMap();
+
+function defaultOf(option) {
+  let value = defaults.get(option);
+  if (value === undefined && !defaults.has(option)) {
+    value = convertDefault(option);
+    defaults.set(option, value);
+  }
+  return Array.isArray(value) ? value.slice() : value;
+}
+
+// A default that does not convert to the option's kind is dropped, as Go
+// drops it (see newSlotSpec in src/go/values.go)
+function convertDefault(option) {
+  const value = option.defaultValue;
+  if (value === undefined || value === null || option.kind === Kind.auto) return value;
+  const text = typeof value === "string" ? value : undefined;
+  switch (option.kind) {
+    case Kind.string: return String(value);
+    case Kind.stringList:
+      return Array.isArray(value) ? value.map(String) : [String(value)];
+    case Kind.list:
+      return Array.isArray(value) ? value.map(String) : String(value).split(",");
+    case Kind.enum: return option.choices.includes(text) ? text : undefined;
+    case Kind.bool:
+      if (text === undefined) return Boolean(value);
+      if (/^(1|t|T|TRUE|true|True)$/.test(text)) return true;
+      return /^(0|f|F|FALSE|false|False)$/.test(text) ? false : undefined;
+    case Kind.float: {
+      const f = text === undefined ? Number(value) : parseFloatText(text);
+      return Number.isNaN(f) ? undefined : f;
+    }
+    case Kind.duration: {
+      const ms = text === undefined ? Number(value) : parseDuration(text);
+      return Number.isNaN(ms) ? undefined : ms;
+    }
+    case Kind.bytes: {
+      const n = text === undefined ? Math.trunc(Number(value)) : parseBytes(text);
+      return Number.isNaN(n) ? undefined : n;
+    }
+    default: {
+      const n = text === undefined ? Math.trunc(Number(value)) : parseInteger(text);
+      return Number.isNaN(n) ? undefined : n;
+    }
+  }
+}
+
+// strconv.ParseFloat, without hexadecimal mantissas
+function parseFloatText(text) {
+  if (/^[+-]?(inf|infinity)$/i.test(text)) return text[0] === "-" ? -Infinity : Infinity;
+  return /^[+-]?(\d+\.?\d*|\.\d+)([eE][+-]?\d+)?$/.test(text) ? Number(text) : NaN;
+}
+
+// strconv.ParseInt with base 0: 0x, 0o and 0b prefixes, a leading 0 for
+// octal, and underscores after a prefix
+function parseInteger(text) {
+  const match = /^([+-]?)(0[xX][0-9a-fA-F_]+|0[oO][0-7_]+|0[bB][01_]+|0[0-7_]*|[1-9][0-9]*)$/.exec(text);
+  if (!match) return NaN;
+  let digits = match[2].replace(/_/g, "");
+  if (/^0[0-7]/.test(digits)) digits = "0o" + digits.slice(1);
+  const n = Number(digits);
+  return match[1] === "-" ? -n : n;
+}
+
+// Nanoseconds in each unit time.ParseDuration accepts
+const durationUnits = {
+  ns: 1, us: 1e3, "\u00b5s": 1e3, "\u03bcs": 1e3, ms: 1e6, s: 1e9, m: 60e9, h: 3600e9
+};
+
+// time.ParseDuration, in milliseconds
+function parseDuration(text) {
+  const match = /^([+-]?)(.*)$/.exec(text);
+  if (match[2] === "0") return 0;
+  const part = /(\d+\.?\d*|\.\d+)([^\d.]+)/y;
+  let ns = 0;
+  let pos = 0;
+  const rest = match[2];
+  while (pos < rest.length) {
+    part.lastIndex = pos;
+    const m = part.exec(rest);
+    if (!m || !Object.prototype.hasOwnProperty.call(durationUnits, m[2])) return NaN;
+    ns += Number(m[1]) * durationUnits[m[2]];
+    pos = part.lastIndex;
+  }
+  if (pos === 0) return NaN;
+  return (match[1] === "-" ? -ns : ns) / 1e6;
+}
+
+// Multipliers of the units ParseBytes in src/go/coerce.go accepts
+const byteUnits = {
+  "": 1, b: 1,
+  k: 2 ** 10, kb: 1e3, kib: 2 ** 10,
+  m: 2 ** 20, mb: 1e6, mib: 2 ** 20,
+  g: 2 ** 30, gb: 1e9, gib: 2 ** 30,
+  t: 2 ** 40, tb: 1e12, tib: 2 ** 40,
+  p: 2 ** 50, pb: 1e15, pib: 2 ** 50
+};
+
+// ParseBytes: a number followed by an optional unit
+function parseBytes(text) {
+  const match = /^([\d.]+)(.*)$/.exec(text);
+  if (!match) return NaN;
+  const unit = match[2].trim().toLowerCase();
+  if (!Object.prototype.hasOwnProperty.call(byteUnits, unit) || !/^(\d+\.?\d*|\.\d+)$/.test(match[1])) {
+    return NaN;
+  }
+  return Math.trunc(Number(match[1]) * byteUnits[unit]);
+}
+
+// Suffix naming the choice Go suggested for a rejected value; hint is the
+// choice's position plus one, 0 for none
+function didYouMean(owner, hint) {
+  return owner && hint !== 0 ? `, did you mean '${owner.choices[hint - 1]}'?` : "";
+}
+
+// Key Go looked an option up under in the config file
+function configKey(option, flag) {
+  return option.configKey || flag.replace(/^--?/, "");
+}
+
+function isList(option) {
+  return option !== undefined && (option.kind === Kind.stringList || option.kind === Kind.list);
+}
+
+module.exports = { ParseResult, Status, Outcome };
@@ -0,0 +1,145 @@
+// Serializes a Command tree into the compact binary schema decoded by
+// DecodeSchema in src/go/schema.go, so the Go engine can rebuild the whole
+// CLI in one call. All integers are little-endian; strings are a uint32
+// byte length followed by UTF-8 bytes. Commands with an action get a
+// non-zero action ID: actions[id - 1] is the command it belongs to.
+
+const SCHEMA_MAGIC = "GMS1";
+
+const ALLOW_UNKNOWN = 1 << 0;
+const ABBREVIATE_COMMANDS = 1 << 1;
+const RESPONSE_FILES = 1 << 2;
+
+const DEFAULT_NONE = 0;
+const DEFAULT_STRING = 1;
+const DEFAULT_NUMBER = 2;
+const DEFAULT_BOOL = 3;
+
+// Option kinds, numbered as OptionKind in src/go/values.go
+const Kind = {
+  auto: 0,
+  bool: 1,
+  int: 2,
+  float: 3,
+  string: 4,
+  stringList: 5,
+  count: 6,
+  duration: 7,
+  bytes: 8,
+  enum: 9,
+  list: 10
+};
+
+class SchemaWriter {
+  constructor(size = 4096) {
+    this.buf = Buffer.allocUnsafe(size);
+    this.pos = 0;
+  }
+
+  reserve(n) {
+    if (this.pos + n <= this.buf.length) return;
+    let size = this.buf.length * 2;
+    while (size < this.pos + n) size *= 2;
+    const next = Buffer.allocUnsafe(size);
+    this.buf.copy(next, 0, 0, this.pos);
+    this.buf = next;
+  }
+
+  u8(v) {
+    this.reserve(1);
+    this.buf[this.pos++] = v;
+  }
+
+  u32(v) {
+    this.reserve(4);
+    this.buf.writeUInt32LE(v, this.pos);
+    this.pos += 4;
+  }
+
+  f64(v) {
+    this.reserve(8);
+    this.buf.writeDoubleLE(v, this.pos);
+    this.pos += 8;
+  }
+
+  str(s) {
+    s = s === undefined || s === null ? "" : String(s);
+    // UTF-8 needs at most three bytes per UTF-16 code unit
+    this.reserve(4 + s.length * 3);
+    const n = this.buf.write(s, this.pos + 4, "utf8");
+    this.buf.writeUInt32LE(n, this.pos);
+    this.pos += 4 + n;
+  }
+
+  finish() {
+    return this.buf.subarray(0, this.pos);
+  }
+}
+
+function writeDefault(w, value) {
+  if (value === undefined || value === null) {
+    w.u8(DEFAULT_NONE);
+  } else if (typeof value === "number") {
+    w.u8(DEFAULT_NUMBER);
+    w.f64(value);
+  } else if (typeof value === "boolean") {
+    w.u8(DEFAULT_BOOL);
+    w.u8(value ? 1 : 0);
+  } else {
+    w.u8(DEFAULT_STRING);
+    w.str(value);
+  }
+}
+
+function writeCommand(w, cmd, actions) {
+  w.str(cmd._name);
+  w.str(cmd._description);
+  w.str(cmd._version);
+  w.u8((cmd._allowUnknownOption ? ALLOW_UNKNOWN : 0) |
+       (cmd._abbreviateCommands ? ABBREVIATE_COMMANDS : 0) |
+       (cmd._responseFiles ? RESPONSE_FILES : 0));
+  if (cmd._action) {
+    actions.push(cmd);
+    w.u32(actions.length);
+  } else {
+    w.u32(0);
+  }
+  w.str(cmd._configFile);
+
+  w.u32(cmd._options.size);
+  cmd._options.forEach((option) => {
+    w.str(option.flags);
+    w.str(option.description);
+    // Go reads a number as nanoseconds; JS durations are milliseconds
+    writeDefault(w, option.kind === Kind.duration && typeof option.defaultValue === "number"
+      ? `${option.defaultValue}ms` : option.defaultValue);
+    w.u8(option.kind);
+    w.u32(option.choices.length);
+    for (const choice of option.choices) w.str(choice);
+    w.str(option.envVar);
+    w.str(option.configKey);
+  });
+
+  w.u32(cmd._arguments.length);
+  for (const arg of cmd._arguments) {
+    w.str(arg.name);
+    w.str(arg.description);
+    w.u32(arg.choices.length);
+    for (const choice of arg.choices) w.str(choice);
+  }
+
+  w.u32(cmd._subcommands.size);
+  cmd._subcommands.forEach((child) => writeCommand(w, child, actions));
+}
+
+// Encode a command and all of its subcommands; commands with actions are
+// appended to actions in action ID order
+function encodeSchema(cmd, actions = []) {
+  const w = new SchemaWriter();
+  w.reserve(SCHEMA_MAGIC.length);
+  w.pos += w.buf.write(SCHEMA_MAGIC, w.pos, "latin1");
+  writeCommand(w, cmd, actions);
+  return w.finish();
+}
+
+module.exports = { encodeSchema, Kind };
@@ -49,7 +49,7 @@ async function build() {
           "-buildmode=c-shared",
           "-o",
           "../gommander.dll",
-          "gommander.go",
+          ".",
         ],
         goDir
       );
@@ -67,7 +67,7 @@ async function build() {
           "-buildmode=c-archive",
           "-o",
           "../gommander.a",
-          "gommander.go",
+          ".",
         ],
         goDir
       );
@@ -68,17 +68,17 @@ function fixGoHeader(headerPath) {
     const initDecl = "extern __declspec(dllexport) void Initialize(void);";
     const initFixed = "extern __declspec(dllexport) void _Initialize(void);";
     const parseDecl =
-      "extern __declspec(dllexport) int Parse(void* cmdPtr, int argc, char** argv);";
+      "extern __declspec(dllexport) int Parse(uint64_t cmdHandle, int argc, char** argv);";
     const parseFixed =
-      "extern __declspec(dllexport) int _Parse(void* cmdPtr, int argc, char** argv);";
+      "extern __declspec(dllexport) int _Parse(uint64_t cmdHandle, int argc, char** argv);";
     const addCmdDecl =
-      "extern __declspec(dllexport) void AddCommand(void* parentPtr, void* childPtr);";
+      "extern __declspec(dllexport) void AddCommand(uint64_t parentHandle, uint64_t childHandle);";
     const addCmdFixed =
-      "extern __declspec(dllexport) void _AddCommand(void* parentPtr, void* childPtr);";
+      "extern __declspec(dllexport) void _AddCommand(uint64_t parentHandle, uint64_t childHandle);";
     const createCmdDecl =
-      "extern __declspec(dllexport) void* CreateCommand(char* name);";
+      "extern __declspec(dllexport) uint64_t CreateCommand(char* name);";
     const createCmdFixed =
-      "extern __declspec(dllexport) void* _CreateCommand(char* name);";
+      "extern __declspec(dllexport) uint64_t _CreateCommand(char* name);";
 
     let changed = false;
     if (content.includes(versionDecl)) {
@@ -139,7 +139,7 @@ async function install() {
             "-buildmode=c-shared",
             "-o",
             "../gommander.dll",
-            "gommander.go",
+            ".",
           ],
           goSrcDir
         );
@@ -151,7 +151,7 @@ async function install() {
             "-buildmode=c-archive",
             "-o",
             "../gommander.a",
-            "gommander.go",
+            ".",
           ],
           goSrcDir
         );
@@ -1,6 +1,12 @@
 #include "gommander.h" // Include the Go-generated header
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <napi.h>
+#include <string>
+#include <vector>
 
 // On Windows use DLL loading, on other platforms use static linking
 #if defined(_WIN32)
@@ -12,17 +18,42 @@
 #endif
 #include <windows.h>
 
-typedef void* (*CreateCommandFn)(char*);
-typedef void (*AddCommandFn)(void*, void*);
-typedef int (*ParseFn)(void*, int, char**);
+typedef uint64_t (*CreateCommandFn)(char*);
+typedef void (*AddCommandFn)(uint64_t, uint64_t);
+typedef int (*ParseFn)(uint64_t, int, char**);
 typedef void (*InitializeFn)();
 typedef char* (*VersionFn)();
+typedef void (*AddOptionFn)(uint64_t, char*, char*, char*);
+typedef void (*AddArgumentFn)(uint64_t, char*, char*);
+typedef void (*SetStringFn)(uint64_t, char*);
+typedef void (*AllowUnknownOptionFn)(uint64_t, int);
+typedef int (*ParseIntoFn)(uint64_t, char*, uint32_t*, int, char*, uint32_t*, int, uint32_t*, int, uintptr_t);
+typedef void (*SetDispatchCallbackFn)(void*);
+typedef void (*FreeStringFn)(char*);
+typedef uint64_t (*BuildCommandTreeFn)(uint32_t, char*, int);
+typedef uint64_t (*CreateCommandInFn)(uint32_t, char*);
+typedef void (*DestroyCommandFn)(uint64_t);
+typedef uint32_t (*OpenRegistryFn)();
+typedef void (*CloseRegistryFn)(uint32_t);
 
 static CreateCommandFn CreateCommand_ptr = nullptr;
 static AddCommandFn AddCommand_ptr = nullptr;
 static ParseFn Parse_ptr = nullptr;
 static InitializeFn Initialize_ptr = nullptr;
 static VersionFn Version_ptr = nullptr;
+static AddOptionFn AddOption_ptr = nullptr;
+static AddArgumentFn AddArgument_ptr = nullptr;
+static SetStringFn SetDescription_ptr = nullptr;
+static SetStringFn SetVersion_ptr = nullptr;
+static AllowUnknownOptionFn AllowUnknownOption_ptr = nullptr;
+static ParseIntoFn ParseInto_ptr = nullptr;
+static FreeStringFn FreeString_ptr = nullptr;
+static BuildCommandTreeFn BuildCommandTree_ptr = nullptr;
+static SetDispatchCallbackFn SetDispatchCallback_ptr = nullptr;
+static CreateCommandInFn CreateCommandIn_ptr = nullptr;
+static DestroyCommandFn DestroyCommand_ptr = nullptr;
+static OpenRegistryFn OpenRegistry_ptr = nullptr;
+static CloseRegistryFn CloseRegistry_ptr = nullptr;
 
 static bool LoadGoDll() {
   // Try multiple paths for the DLL
@@ -54,16 +85,53 @@ static bool LoadGoDll() {
   Parse_ptr = (ParseFn)GetProcAddress(h, "Parse");
   Initialize_ptr = (InitializeFn)GetProcAddress(h, "Initialize");
   Version_ptr = (VersionFn)GetProcAddress(h, "Version");
-  return CreateCommand_ptr && AddCommand_ptr && Parse_ptr && Initialize_ptr && Version_ptr;
+  AddOption_ptr = (AddOptionFn)GetProcAddress(h, "AddOption");
+  AddArgument_ptr = (AddArgumentFn)GetProcAddress(h, "AddArgument");
+  SetDescription_ptr = (SetStringFn)GetProcAddress(h, "SetDescription");
+  SetVersion_ptr = (SetStringFn)GetProcAddress(h, "SetVersion");
+  AllowUnknownOption_ptr = (AllowUnknownOptionFn)GetProcAddress(h, "AllowUnknownOption");
+  ParseInto_ptr = (ParseIntoFn)GetProcAddress(h, "ParseInto");
+  FreeString_ptr = (FreeStringFn)GetProcAddress(h, "FreeString");
+  BuildCommandTree_ptr = (BuildCommandTreeFn)GetProcAddress(h, "BuildCommandTree");
+  SetDispatchCallback_ptr = (SetDispatchCallbackFn)GetProcAddress(h, "SetDispatchCallback");
+  CreateCommandIn_ptr = (CreateCommandInFn)GetProcAddress(h, "CreateCommandIn");
+  DestroyCommand_ptr = (DestroyCommandFn)GetProcAddress(h, "DestroyCommand");
+  OpenRegistry_ptr = (OpenRegistryFn)GetProcAddress(h, "OpenRegistry");
+  CloseRegistry_ptr = (CloseRegistryFn)GetProcAddress(h, "CloseRegistry");
+  return CreateCommand_ptr && AddCommand_ptr && Parse_ptr && Initialize_ptr && Version_ptr &&
+         AddOption_ptr && AddArgument_ptr && SetDescription_ptr && SetVersion_ptr &&
+         AllowUnknownOption_ptr && ParseInto_ptr && FreeString_ptr && BuildCommandTree_ptr &&
+         SetDispatchCallback_ptr && CreateCommandIn_ptr && DestroyCommand_ptr && OpenRegistry_ptr &&
+         CloseRegistry_ptr;
 }
+
+// Resolve a Go export through the runtime-loaded DLL
+#define GO_CALL(fn) (::fn##_ptr)
 #else
 extern "C" {
-void* CreateCommand(char* name);
-void AddCommand(void* parentPtr, void* childPtr);
-int Parse(void* cmdPtr, int argc, char** argv);
+uint64_t CreateCommand(char* name);
+void AddCommand(uint64_t parentHandle, uint64_t childHandle);
+int Parse(uint64_t cmdHandle, int argc, char** argv);
 void Initialize(void);
 char* Version(void);
+void AddOption(uint64_t cmdHandle, char* flags, char* description, char* defaultValue);
+void AddArgument(uint64_t cmdHandle, char* name, char* description);
+void SetDescription(uint64_t cmdHandle, char* description);
+void SetVersion(uint64_t cmdHandle, char* version);
+void AllowUnknownOption(uint64_t cmdHandle, int allow);
+int ParseInto(uint64_t cmdHandle, char* blob, uint32_t* offsets, int argc, char* envBlob, uint32_t* envOffsets,
+              int envc, uint32_t* out, int outWords, uintptr_t dispatchCtx);
+void SetDispatchCallback(void* fn);
+void FreeString(char* str);
+uint64_t BuildCommandTree(uint32_t registry, char* data, int length);
+uint64_t CreateCommandIn(uint32_t registry, char* name);
+void DestroyCommand(uint64_t cmdHandle);
+uint32_t OpenRegistry(void);
+void CloseRegistry(uint32_t registry);
 }
+
+// Resolve a statically linked Go export
+#define GO_CALL(fn) (::fn)
 #endif
 
 // Simple function to test the addon
@@ -72,6 +140,8 @@ Napi::String Method(const Napi::CallbackInfo &info) {
   return Napi::String::New(env, "commander-go addon loaded successfully");
 }
 
+static void StartGo();
+
 // Get version from Go
 Napi::String GetVersion(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
@@ -80,35 +150,508 @@ Napi::String GetVersion(const Napi::CallbackInfo &info) {
   if (!Version_ptr) {
     if (!LoadGoDll()) return Napi::String::New(env, "Go DLL not loaded");
   }
-  char* version = Version_ptr();
-#else
-  char* version = Version();
 #endif
-  return Napi::String::New(env, version);
+  StartGo();
+  // Version returns a C.CString, which Go leaves for the caller to free
+  char* version = GO_CALL(Version)();
+  Napi::String result = Napi::String::New(env, version);
+  GO_CALL(FreeString)(version);
+  return result;
+}
+
+// ArgvArena packs a JS argument array into one contiguous UTF-8 blob plus an
+// offsets table (argument i is bytes[offsets[i], offsets[i + 1])), which Go
+// views in place instead of copying every argument
+struct ArgvArena {
+  std::string bytes;
+  std::vector<uint32_t> offsets;
+
+  void Pack(Napi::Env env, Napi::Array array) {
+    uint32_t argc = array.Length();
+    bytes.clear();
+    offsets.clear();
+    offsets.reserve(argc + 1);
+    offsets.push_back(0);
+
+    for (uint32_t i = 0; i < argc; i++) {
+      Napi::Value value = array.Get(i);
+      if (!value.IsString()) {
+        value = value.ToString();
+      }
+
+      // Write straight into the arena: first ask for the UTF-8 length, then
+      // copy into the reserved tail (napi always NUL-terminates, so reserve
+      // one extra byte that the next argument overwrites)
+      size_t length = 0;
+      napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+      size_t pos = bytes.size();
+      bytes.resize(pos + length + 1);
+      napi_get_value_string_utf8(env, value, &bytes[pos], length + 1, &length);
+      bytes.resize(pos + length);
+      offsets.push_back(static_cast<uint32_t>(bytes.size()));
+    }
+  }
+
+  char* Blob() { return const_cast<char*>(bytes.data()); }
+  uint32_t* Offsets() { return offsets.data(); }
+  int Argc() const { return static_cast<int>(offsets.size() - 1); }
+};
+
+// ParseArenas are the arenas of one parse: its arguments and, if the
+// caller passed one, its "NAME=value" environment, which Go looks option
+// environment variables up in instead of its own startup copy
+struct ParseArenas {
+  ArgvArena args;
+  ArgvArena env;
+  bool hasEnv = false;
+
+  void Pack(Napi::Env napiEnv, Napi::Array argv, Napi::Value environ) {
+    args.Pack(napiEnv, argv);
+    hasEnv = environ.IsArray();
+    if (hasEnv) {
+      env.Pack(napiEnv, environ.As<Napi::Array>());
+    }
+  }
+
+  int Parse(uint64_t handle, uint32_t* out, int outWords, uintptr_t ctx) {
+    return GO_CALL(ParseInto)(handle, args.Blob(), args.Offsets(), args.Argc(), env.Blob(), env.Offsets(),
+                              hasEnv ? env.Argc() : -1, out, outWords, ctx);
+  }
+};
+
+// A dispatch queued onto the JS thread; owns a copy of the result words
+struct DispatchCall {
+  uint32_t action;
+  uint32_t token;
+  std::vector<uint32_t> words;
+};
+
+static void CallAction(Napi::Env env, Napi::Function, DispatchCall* call);
+
+// ActionQueue carries the dispatches of parses running off the JS thread
+// back onto it. It is shared with those parses, which may outlive the
+// environment, and stops accepting calls once the environment shuts down.
+struct ActionQueue {
+  std::mutex mutex;
+  Napi::ThreadSafeFunction tsfn;
+  bool open = false;
+
+  // Queue call, or report that the environment no longer takes calls;
+  // the caller keeps ownership of call on failure
+  bool Call(DispatchCall* call) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return open && tsfn.NonBlockingCall(call, CallAction) == napi_ok;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (open) {
+      tsfn.Release();
+      open = false;
+    }
+  }
+};
+
+// AddonData is the per-environment state of the addon. The main thread and
+// every worker_thread that loads the addon get their own instance, each
+// with its own Go registry, so environments never share or reset each
+// other's commands.
+struct AddonData {
+  bool opened = false;
+  uint32_t registry = 0;
+
+  // The JS function that runs actions (see setDispatcher). The actions
+  // themselves stay in JS, so native code holds nothing that keeps a
+  // command alive.
+  Napi::FunctionReference dispatcher;
+  std::shared_ptr<ActionQueue> queue;
+};
+
+static void CallAction(Napi::Env env, Napi::Function, DispatchCall* call) {
+  if (env != nullptr) {
+    AddonData* data = env.GetInstanceData<AddonData>();
+    Napi::Uint32Array words = Napi::Uint32Array::New(env, call->words.size());
+    std::copy(call->words.begin(), call->words.end(), words.Data());
+    data->dispatcher.Call({Napi::Number::New(env, call->action), words, Napi::Number::New(env, call->token)});
+  }
+  delete call;
+}
+
+// DispatchContext is the opaque value handed to ParseInto and passed back
+// to DispatchAction. env is only set for parses running on the JS thread,
+// queue only for the others.
+struct DispatchContext {
+  uint32_t token;  // lets JS match the dispatch to its parse call
+  Napi::Env* env;
+  std::shared_ptr<ActionQueue> queue;
+  bool failed = false;  // the action could not be queued
+};
+
+// Called by Go (see src/go/dispatch.go) when a parse matches a command with
+// an action. Runs the action immediately when already on the JS thread,
+// otherwise queues it onto the JS thread.
+static void DispatchAction(uintptr_t ctx, uint32_t action, uint32_t* words, int count) {
+  DispatchContext* dispatch = reinterpret_cast<DispatchContext*>(ctx);
+  if (dispatch->env != nullptr) {
+    Napi::Env env = *dispatch->env;
+    AddonData* data = env.GetInstanceData<AddonData>();
+    if (data->dispatcher.IsEmpty()) {
+      return;
+    }
+    Napi::Uint32Array array = Napi::Uint32Array::New(env, count);
+    std::copy(words, words + count, array.Data());
+    data->dispatcher.Call({Napi::Number::New(env, action), array, Napi::Number::New(env, dispatch->token)});
+    return;
+  }
+
+  DispatchCall* call = new DispatchCall{action, dispatch->token, std::vector<uint32_t>(words, words + count)};
+  if (dispatch->queue == nullptr || !dispatch->queue->Call(call)) {
+    delete call;
+    dispatch->failed = true;
+  }
+}
+
+// Loading the addon starts the Go runtime: the c-archive starts it from a
+// library constructor, and on Windows LoadGoDll starts it. Only what the
+// addon itself sets up waits for a command or the version to be first
+// needed. StartGo does that process-wide setup once, whichever
+// environment gets there first. Its first call into Go also waits for the
+// runtime to finish initializing.
+static void StartGo() {
+  static std::once_flag started;
+  std::call_once(started, []() {
+    GO_CALL(Initialize)();
+    // Let Go run JS actions for the commands it dispatches to
+    GO_CALL(SetDispatchCallback)(reinterpret_cast<void*>(&DispatchAction));
+  });
+}
+
+// EnvRegistry returns the Go registry of an environment, opening it on first
+// use. Every Go command the environment created is released when it (e.g. a
+// worker_thread) shuts down.
+static uint32_t EnvRegistry(Napi::Env env) {
+  AddonData* data = env.GetInstanceData<AddonData>();
+  if (!data->opened) {
+    StartGo();
+    data->registry = GO_CALL(OpenRegistry)();
+    data->opened = true;
+    uint32_t registry = data->registry;
+    env.AddCleanupHook([registry]() { GO_CALL(CloseRegistry)(registry); });
+  }
+  return data->registry;
+}
+
+// Status written by ParseInto when the output buffer cannot hold the result
+// (resultStatusTooSmall in src/go/result.go); word 1 then holds the size
+static const int kStatusTooSmall = 101;
+
+// ParseWorker runs ParseInto on the libuv threadpool so that parsing large
+// argument vectors does not block the event loop. The arena is packed on
+// the main thread before queueing, and the packed result is handed back to
+// JS as a fresh Uint32Array.
+class ParseWorker : public Napi::AsyncWorker {
+ public:
+  ParseWorker(Napi::Env env, Napi::Object owner, uint64_t handle, std::shared_ptr<ActionQueue> queue,
+              uint32_t token)
+      : Napi::AsyncWorker(env, "gommander:parseAsync"),
+        deferred_(Napi::Promise::Deferred::New(env)),
+        owner_(Napi::Persistent(owner)),
+        handle_(handle),
+        dispatch_{token, nullptr, std::move(queue)} {}
+
+  ParseArenas& Arenas() { return arenas_; }
+  Napi::Promise Promise() { return deferred_.Promise(); }
+
+  void Execute() override {
+    uintptr_t ctx = reinterpret_cast<uintptr_t>(&dispatch_);
+    out_.resize(256);
+    int status = arenas_.Parse(handle_, out_.data(), static_cast<int>(out_.size()), ctx);
+    if (status == kStatusTooSmall) {
+      out_.resize(out_[1]);
+      arenas_.Parse(handle_, out_.data(), static_cast<int>(out_.size()), ctx);
+    }
+  }
+
+  void OnOK() override {
+    // Without this the caller would wait for an action that never runs
+    if (dispatch_.failed) {
+      deferred_.Reject(Napi::Error::New(Env(), "cannot queue the action onto the JS thread").Value());
+      return;
+    }
+    size_t size = std::min<size_t>(out_[1], out_.size());
+    Napi::Uint32Array words = Napi::Uint32Array::New(Env(), size);
+    std::copy(out_.begin(), out_.begin() + size, words.Data());
+    deferred_.Resolve(words);
+  }
+
+  void OnError(const Napi::Error& error) override {
+    deferred_.Reject(error.Value());
+  }
+
+ private:
+  Napi::Promise::Deferred deferred_;
+  Napi::ObjectReference owner_;  // keeps the NativeCommand alive meanwhile
+  uint64_t handle_;
+  DispatchContext dispatch_;
+  ParseArenas arenas_;
+  std::vector<uint32_t> out_;
+};
+
+// NativeCommand wraps a Go command handle so that JS commands can be
+// defined and parsed by the Go engine
+class NativeCommand : public Napi::ObjectWrap<NativeCommand> {
+ public:
+  static Napi::Function GetClass(Napi::Env env) {
+    return DefineClass(env, "NativeCommand", {
+      InstanceMethod("addCommand", &NativeCommand::AddSubcommand),
+      InstanceMethod("addOption", &NativeCommand::AddOptionMethod),
+      InstanceMethod("addArgument", &NativeCommand::AddArgumentMethod),
+      InstanceMethod("setDescription", &NativeCommand::SetDescriptionMethod),
+      InstanceMethod("setVersion", &NativeCommand::SetVersionMethod),
+      InstanceMethod("allowUnknownOption", &NativeCommand::AllowUnknownOptionMethod),
+      InstanceMethod("parse", &NativeCommand::ParseMethod),
+      InstanceMethod("parseAsync", &NativeCommand::ParseAsyncMethod),
+      InstanceMethod("destroy", &NativeCommand::DestroyMethod),
+    });
+  }
+
+  // new NativeCommand(name?: string) creates a single empty command;
+  // new NativeCommand(schema: Buffer) rebuilds a whole serialized tree
+  // (lib/schema.js) in one call into Go
+  NativeCommand(const Napi::CallbackInfo& info) : Napi::ObjectWrap<NativeCommand>(info) {
+    uint32_t registry = EnvRegistry(info.Env());
+    if (info.Length() > 0 && info[0].IsBuffer()) {
+      Napi::Buffer<char> schema = info[0].As<Napi::Buffer<char>>();
+      handle_ = GO_CALL(BuildCommandTree)(registry, schema.Data(), static_cast<int>(schema.Length()));
+      if (handle_ == 0) {
+        Napi::Error::New(info.Env(), "invalid command schema").ThrowAsJavaScriptException();
+      }
+      return;
+    }
+
+    std::string name = info.Length() > 0 && info[0].IsString()
+                           ? info[0].As<Napi::String>().Utf8Value()
+                           : std::string();
+    handle_ = GO_CALL(CreateCommandIn)(registry, const_cast<char*>(name.c_str()));
+  }
+
+  // Runs as the N-API finalizer once the JS object is collected, so Go
+  // commands are released even if destroy() was never called
+  ~NativeCommand() { Release(); }
+
+  uint64_t Handle() const { return handle_; }
+
+ private:
+  void Release() {
+    if (handle_ != 0) {
+      GO_CALL(DestroyCommand)(handle_);
+      handle_ = 0;
+    }
+  }
+
+  // destroy() releases the Go command tree right away; later calls on this
+  // object report an invalid handle
+  Napi::Value DestroyMethod(const Napi::CallbackInfo& info) {
+    Release();
+    return info.Env().Undefined();
+  }
+
+  // addCommand(child: NativeCommand)
+  Napi::Value AddSubcommand(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsObject()) {
+      Napi::TypeError::New(env, "addCommand expects a NativeCommand").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    NativeCommand* child = NativeCommand::Unwrap(info[0].As<Napi::Object>());
+    if (child == nullptr) {
+      return env.Undefined();
+    }
+    GO_CALL(AddCommand)(handle_, child->Handle());
+    return env.Undefined();
+  }
+
+  // addOption(flags: string, description?: string, defaultValue?: string)
+  Napi::Value AddOptionMethod(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "addOption expects a flags string").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    std::string flags = info[0].As<Napi::String>().Utf8Value();
+    std::string description = StringArg(info, 1);
+    bool hasDefault = info.Length() > 2 && info[2].IsString();
+    std::string defaultValue = StringArg(info, 2);
+    GO_CALL(AddOption)(handle_, const_cast<char*>(flags.c_str()),
+                       const_cast<char*>(description.c_str()),
+                       hasDefault ? const_cast<char*>(defaultValue.c_str()) : nullptr);
+    return env.Undefined();
+  }
+
+  // addArgument(name: string, description?: string)
+  Napi::Value AddArgumentMethod(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "addArgument expects a name string").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    std::string description = StringArg(info, 1);
+    GO_CALL(AddArgument)(handle_, const_cast<char*>(name.c_str()),
+                         const_cast<char*>(description.c_str()));
+    return env.Undefined();
+  }
+
+  Napi::Value SetDescriptionMethod(const Napi::CallbackInfo& info) {
+    std::string description = StringArg(info, 0);
+    GO_CALL(SetDescription)(handle_, const_cast<char*>(description.c_str()));
+    return info.Env().Undefined();
+  }
+
+  Napi::Value SetVersionMethod(const Napi::CallbackInfo& info) {
+    std::string version = StringArg(info, 0);
+    GO_CALL(SetVersion)(handle_, const_cast<char*>(version.c_str()));
+    return info.Env().Undefined();
+  }
+
+  Napi::Value AllowUnknownOptionMethod(const Napi::CallbackInfo& info) {
+    bool allow = info.Length() < 1 || info[0].ToBoolean().Value();
+    GO_CALL(AllowUnknownOption)(handle_, allow ? 1 : 0);
+    return info.Env().Undefined();
+  }
+
+  // parse(args: string[], out: Uint32Array, token?: number, env?: string[])
+  // -> status. Go writes the packed result (src/go/result.go) straight into
+  // out and runs the matched action synchronously before returning. env
+  // holds "NAME=value" entries for the variables options name.
+  Napi::Value ParseMethod(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsArray() || !info[1].IsTypedArray() ||
+        info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array) {
+      Napi::TypeError::New(env, "parse expects an array of strings and a Uint32Array")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    // An action may parse again before this call returns, while Go still
+    // views the arena of this one; each nesting level packs into its own
+    ArenaLevel level(this);
+    ParseArenas& arenas = level.Arenas();
+    arenas.Pack(env, info[0].As<Napi::Array>(), info[3]);
+    Napi::Uint32Array out = info[1].As<Napi::Uint32Array>();
+    DispatchContext dispatch{TokenArg(info, 2), &env, nullptr};
+    int status = arenas.Parse(handle_, out.Data(), static_cast<int>(out.ElementLength()),
+                              reinterpret_cast<uintptr_t>(&dispatch));
+    return Napi::Number::New(env, status);
+  }
+
+  // parseAsync(args: string[], token?: number, env?: string[]) -> Promise<Uint32Array>
+  // Same result layout as parse, computed on the threadpool; the matched
+  // action is queued onto the JS thread, and the promise rejects if that
+  // fails
+  Napi::Value ParseAsyncMethod(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsArray()) {
+      Napi::TypeError::New(env, "parseAsync expects an array of strings").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    AddonData* data = env.GetInstanceData<AddonData>();
+    ParseWorker* worker = new ParseWorker(env, Value(), handle_, data->queue, TokenArg(info, 1));
+    worker->Arenas().Pack(env, info[0].As<Napi::Array>(), info[2]);
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+  }
+
+  static uint32_t TokenArg(const Napi::CallbackInfo& info, size_t index) {
+    return info.Length() > index && info[index].IsNumber() ? info[index].As<Napi::Number>().Uint32Value() : 0;
+  }
+
+  static std::string StringArg(const Napi::CallbackInfo& info, size_t index) {
+    if (info.Length() > index && info[index].IsString()) {
+      return info[index].As<Napi::String>().Utf8Value();
+    }
+    return std::string();
+  }
+
+  // ArenaLevel claims the arena of the next nesting level of parse() for
+  // its scope, creating it on first use
+  class ArenaLevel {
+   public:
+    explicit ArenaLevel(NativeCommand* owner) : owner_(owner) {
+      if (owner_->depth_ == owner_->arenas_.size()) {
+        owner_->arenas_.emplace_back(new ParseArenas());
+      }
+      arenas_ = owner_->arenas_[owner_->depth_++].get();
+    }
+    ~ArenaLevel() { owner_->depth_--; }
+    ParseArenas& Arenas() { return *arenas_; }
+
+   private:
+    NativeCommand* owner_;
+    ParseArenas* arenas_;
+  };
+
+  uint64_t handle_ = 0;
+  // Arenas of parse() by nesting level, reused across parses to avoid
+  // reallocating
+  std::vector<std::unique_ptr<ParseArenas>> arenas_;
+  size_t depth_ = 0;
+};
+
+// setDispatcher(fn: (action: number, words: Uint32Array, token: number) => void)
+// Sets the JS function that runs the action with this ID for the parse
+// call the token names, in this environment
+static Napi::Value SetDispatcher(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsFunction()) {
+    Napi::TypeError::New(env, "setDispatcher expects a function").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  Napi::Function fn = info[0].As<Napi::Function>();
+  AddonData* data = env.GetInstanceData<AddonData>();
+  data->dispatcher = Napi::Persistent(fn);
+
+  if (data->queue == nullptr) {
+    std::shared_ptr<ActionQueue> queue = std::make_shared<ActionQueue>();
+    queue->tsfn = Napi::ThreadSafeFunction::New(env, fn, "gommander:action", 0, 1);
+    // The queue must not keep the process alive on its own
+    queue->tsfn.Unref(env);
+    queue->open = true;
+    data->queue = queue;
+    // Hooks run in reverse order of registration, so this one releases the
+    // queue before Node finalizes its ThreadSafeFunction at teardown
+    env.AddCleanupHook([queue]() { queue->Close(); });
+  }
+  return env.Undefined();
 }
 
 // Initialize the addon
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
-  // Initialize Go runtime (cgo-exported symbol)
 #if defined(_WIN32)
-  if (!Initialize_ptr) {
-    if (!LoadGoDll()) {
-      // Could not load Go runtime; still export functions but they'll return errors
-      exports.Set(Napi::String::New(env, "hello"),
-                  Napi::Function::New(env, [](const Napi::CallbackInfo& info) {
-                    return Napi::String::New(info.Env(), "Go DLL not loaded");
-                  }));
-      exports.Set(Napi::String::New(env, "version"),
-                  Napi::Function::New(env, [](const Napi::CallbackInfo& info) {
-                    return Napi::String::New(info.Env(), "Go DLL not loaded");
-                  }));
-      return exports;
-    }
-  }
-  Initialize_ptr();
-#else
-  Initialize();
+  // Worker threads may initialize concurrently; load the DLL only once
+  static std::mutex loadMutex;
+  bool loaded;
+  {
+    std::lock_guard<std::mutex> lock(loadMutex);
+    loaded = Initialize_ptr != nullptr || LoadGoDll();
+  }
+  if (!loaded) {
+    // Could not load Go runtime; still export functions but they'll return errors
+    exports.Set(Napi::String::New(env, "hello"),
+                Napi::Function::New(env, [](const Napi::CallbackInfo& info) {
+                  return Napi::String::New(info.Env(), "Go DLL not loaded");
+                }));
+    exports.Set(Napi::String::New(env, "version"),
+                Napi::Function::New(env, [](const Napi::CallbackInfo& info) {
+                  return Napi::String::New(info.Env(), "Go DLL not loaded");
+                }));
+    return exports;
+  }
 #endif
+  // No Go calls yet; see StartGo and EnvRegistry
+  env.SetInstanceData(new AddonData());
 
   // Export functions (wrap in lambdas to avoid overload resolution issues)
   exports.Set(Napi::String::New(env, "hello"),
@@ -119,6 +662,8 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
               Napi::Function::New(env, [](const Napi::CallbackInfo& info) {
                 return GetVersion(info);
               }));
+  exports.Set(Napi::String::New(env, "NativeCommand"), NativeCommand::GetClass(env));
+  exports.Set(Napi::String::New(env, "setDispatcher"), Napi::Function::New(env, SetDispatcher));
 
   return exports;
 }
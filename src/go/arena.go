@@ -0,0 +1,29 @@
+package main
+
+import "unsafe"
+
+// An argv arena is how the addon hands a whole argument vector to Go in one
+// piece: every argument is stored back to back as UTF-8 in a single blob, and
+// an offsets table of argc+1 entries marks the boundaries, so argument i is
+// blob[offsets[i]:offsets[i+1]].
+
+// viewArena returns the arguments of a packed argv arena as Go strings that
+// alias the arena memory. Nothing is copied, so the strings are only valid
+// while the caller keeps the arena alive and must not be retained beyond
+// the call that received them.
+func viewArena(blob unsafe.Pointer, offsets []uint32) []string {
+	if len(offsets) < 2 {
+		return nil
+	}
+	return appendArena(make([]string, 0, len(offsets)-1), blob, offsets)
+}
+
+// appendArena is viewArena appending the views to dst, so that reusing dst
+// makes viewing an arena allocation-free
+func appendArena(dst []string, blob unsafe.Pointer, offsets []uint32) []string {
+	for i := 0; i+1 < len(offsets); i++ {
+		start, end := offsets[i], offsets[i+1]
+		dst = append(dst, unsafe.String((*byte)(unsafe.Add(blob, start)), int(end-start)))
+	}
+	return dst
+}
@@ -0,0 +1,49 @@
+package main
+
+import (
+	"testing"
+	"unsafe"
+)
+
+func TestViewArena(t *testing.T) {
+	blob := []byte("serve--port8080été")
+	offsets := []uint32{0, 5, 5, 11, 15, uint32(len(blob))}
+
+	args := viewArena(unsafe.Pointer(&blob[0]), offsets)
+	want := []string{"serve", "", "--port", "8080", "été"}
+	if len(args) != len(want) {
+		t.Fatalf("got %d args, want %d", len(args), len(want))
+	}
+	for i := range want {
+		if args[i] != want[i] {
+			t.Errorf("arg %d = %q, want %q", i, args[i], want[i])
+		}
+	}
+
+	// The views alias the arena rather than copying it
+	if unsafe.StringData(args[0]) != &blob[0] {
+		t.Error("expected arguments to alias the arena")
+	}
+
+	if args := viewArena(nil, []uint32{0}); args != nil {
+		t.Errorf("expected no arguments for an empty arena, got %q", args)
+	}
+}
+
+func BenchmarkViewArena(b *testing.B) {
+	// 50k paths, as passed by xargs-style invocations
+	const n = 50000
+	var blob []byte
+	offsets := make([]uint32, 0, n+1)
+	offsets = append(offsets, 0)
+	for i := 0; i < n; i++ {
+		blob = append(blob, "src/components/widgets/file.tsx"...)
+		offsets = append(offsets, uint32(len(blob)))
+	}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		viewArena(unsafe.Pointer(&blob[0]), offsets)
+	}
+}
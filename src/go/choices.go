@@ -0,0 +1,186 @@
+package main
+
+import "sort"
+
+// choiceMapThreshold is the size from which a choiceSet switches from a
+// sorted array to a hash map. Below it a binary search over a few strings
+// beats hashing the value.
+const choiceMapThreshold = 32
+
+// choiceSet is the compiled form of a list of allowed values. Lookups
+// return the position of the value in the declared list.
+type choiceSet struct {
+	values  []string
+	longest int // length of the longest choice
+
+	// Exactly one of sorted and index is set
+	sorted []choiceEntry
+	index  map[string]int32
+}
+
+type choiceEntry struct {
+	value    string
+	position int32
+}
+
+// newChoiceSet compiles choices, or returns nil if there are none. A value
+// declared twice keeps its first position.
+func newChoiceSet(choices []string) *choiceSet {
+	if len(choices) == 0 {
+		return nil
+	}
+	set := &choiceSet{values: choices}
+	for _, choice := range choices {
+		if len(choice) > set.longest {
+			set.longest = len(choice)
+		}
+	}
+	if len(choices) >= choiceMapThreshold {
+		set.index = make(map[string]int32, len(choices))
+		for i := len(choices) - 1; i >= 0; i-- {
+			set.index[choices[i]] = int32(i)
+		}
+		return set
+	}
+
+	set.sorted = make([]choiceEntry, len(choices))
+	for i, choice := range choices {
+		set.sorted[i] = choiceEntry{value: choice, position: int32(i)}
+	}
+	sort.SliceStable(set.sorted, func(i, j int) bool {
+		return set.sorted[i].value < set.sorted[j].value
+	})
+	return set
+}
+
+// find returns the position of value among the choices, or -1
+func (s *choiceSet) find(value string) int {
+	if s.index != nil {
+		if i, ok := s.index[value]; ok {
+			return int(i)
+		}
+		return -1
+	}
+
+	lo, hi := 0, len(s.sorted)
+	for lo < hi {
+		mid := int(uint(lo+hi) >> 1)
+		if s.sorted[mid].value < value {
+			lo = mid + 1
+		} else {
+			hi = mid
+		}
+	}
+	if lo < len(s.sorted) && s.sorted[lo].value == value {
+		return int(s.sorted[lo].position)
+	}
+	return -1
+}
+
+// choiceError reports a value that is not among the choices of a set.
+// It matches errNotAChoice with errors.Is.
+type choiceError struct {
+	value      string
+	suggestion int // position of the closest choice, or -1
+	set        *choiceSet
+}
+
+func (e *choiceError) Error() string {
+	return errNotAChoice.Error()
+}
+
+func (e *choiceError) Is(target error) bool {
+	return target == errNotAChoice
+}
+
+// miss builds the error for a value that find rejected. The suggestion is
+// worked out here, so accepted values never pay for it.
+func (s *choiceSet) miss(value string) error {
+	if s == nil {
+		return errNotAChoice
+	}
+	return &choiceError{value: value, suggestion: s.suggest(value), set: s}
+}
+
+// suggest returns the position of the choice closest to a rejected value,
+// or -1 if none is close enough to be worth offering. Closeness is the
+// edit distance (insertions, deletions, substitutions and adjacent
+// transpositions), allowed up to a third of the value's length and at
+// least one edit, but never every byte of the value. Ties go to the choice
+// declared first.
+func (s *choiceSet) suggest(value string) int {
+	limit := len(value) / 3
+	if limit < 1 {
+		limit = 1
+	}
+	if limit >= len(value) {
+		limit = len(value) - 1
+	}
+	if limit < 1 {
+		return -1
+	}
+
+	best, bestDistance := -1, limit+1
+	var rows [3][]int
+	width := s.longest + 1
+	scratch := make([]int, 3*width)
+	for i := range rows {
+		rows[i] = scratch[i*width : (i+1)*width]
+	}
+	for i, choice := range s.values {
+		// Lengths alone rule out most candidates of a large set
+		if diff := len(choice) - len(value); diff >= bestDistance || -diff >= bestDistance {
+			continue
+		}
+		if d := editDistance(value, choice, bestDistance-1, &rows); d < bestDistance {
+			best, bestDistance = i, d
+		}
+	}
+	return best
+}
+
+// editDistance returns the optimal string alignment distance between a
+// and b, or limit+1 as soon as it is known to exceed limit. rows is
+// scratch space with room for len(b)+1 entries each, reused across calls.
+func editDistance(a, b string, limit int, rows *[3][]int) int {
+	for i := range rows {
+		rows[i] = rows[i][:len(b)+1]
+	}
+	prev2, prev, cur := rows[0], rows[1], rows[2]
+	for j := range prev {
+		prev[j] = j
+	}
+
+	for i := 1; i <= len(a); i++ {
+		cur[0] = i
+		rowMin := i
+		for j := 1; j <= len(b); j++ {
+			cost := 1
+			if a[i-1] == b[j-1] {
+				cost = 0
+			}
+			d := prev[j-1] + cost
+			if prev[j]+1 < d {
+				d = prev[j] + 1
+			}
+			if cur[j-1]+1 < d {
+				d = cur[j-1] + 1
+			}
+			if i > 1 && j > 1 && a[i-1] == b[j-2] && a[i-2] == b[j-1] && prev2[j-2]+1 < d {
+				d = prev2[j-2] + 1
+			}
+			cur[j] = d
+			if d < rowMin {
+				rowMin = d
+			}
+		}
+		if rowMin > limit {
+			return limit + 1
+		}
+		prev2, prev, cur = prev, cur, prev2
+	}
+	if prev[len(b)] > limit {
+		return limit + 1
+	}
+	return prev[len(b)]
+}
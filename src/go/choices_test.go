@@ -0,0 +1,171 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"testing"
+)
+
+// regions returns n distinct choices shaped like cloud region names
+func regions(n int) []string {
+	areas := []string{"us-east", "us-west", "eu-central", "eu-west", "ap-south", "ap-northeast", "sa-east", "ca-central"}
+	choices := make([]string, n)
+	for i := range choices {
+		choices[i] = fmt.Sprintf("%s-%d", areas[i%len(areas)], i/len(areas)+1)
+	}
+	return choices
+}
+
+func TestChoiceSetFind(t *testing.T) {
+	for _, n := range []int{1, 5, choiceMapThreshold - 1, choiceMapThreshold, 500} {
+		choices := regions(n)
+		set := newChoiceSet(choices)
+		if (set.index != nil) != (n >= choiceMapThreshold) {
+			t.Errorf("%d choices: map used = %v", n, set.index != nil)
+		}
+		for i, choice := range choices {
+			if got := set.find(choice); got != i {
+				t.Errorf("%d choices: find(%q) = %d, want %d", n, choice, got, i)
+			}
+		}
+		for _, miss := range []string{"", "us-east", "us-east-1x", "zz"} {
+			if got := set.find(miss); got != -1 {
+				t.Errorf("%d choices: find(%q) = %d, want -1", n, miss, got)
+			}
+		}
+	}
+
+	// Duplicates keep their first position in both layouts
+	for _, n := range []int{3, choiceMapThreshold} {
+		choices := append(regions(n), "us-east-1")
+		if got := newChoiceSet(choices).find("us-east-1"); got != 0 {
+			t.Errorf("%d choices: duplicate found at %d", n, got)
+		}
+	}
+}
+
+func TestChoiceSetSuggest(t *testing.T) {
+	set := newChoiceSet(regions(200))
+	tests := []struct {
+		value, want string
+	}{
+		{"us-est-1", "us-east-1"},  // deletion
+		{"us-eats-1", "us-east-1"}, // transposition
+		{"eu-centrl-12", "eu-central-12"},
+		{"ap-northeast-99", "ap-northeast-9"},
+		{"mars-1", ""},
+		{"x", ""},
+	}
+	for _, tt := range tests {
+		got := ""
+		if i := set.suggest(tt.value); i >= 0 {
+			got = set.values[i]
+		}
+		if got != tt.want {
+			t.Errorf("suggest(%q) = %q, want %q", tt.value, got, tt.want)
+		}
+	}
+}
+
+func TestChoiceErrors(t *testing.T) {
+	cmd, o := newTestCommand("deploy",
+		NewOption("--zones <list>", "Zones").SetChoices([]string{"a", "b", "c"}).SetKind(KindList),
+		NewOption("--region <region>", "Region").SetChoices(regions(300)),
+	)
+	cmd.AddArgument(NewArgument("<size>", "Instance size").SetChoices([]string{"small", "medium", "large"}))
+
+	result, err := cmd.ParseArgs([]string{"--region", "eu-west-7", "--zones", "a,c", "medium"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.String(o["region"]) != "eu-west-7" {
+		t.Errorf("region = %q", result.String(o["region"]))
+	}
+
+	tests := []struct {
+		args    []string
+		code    ErrorCode
+		message string
+	}{
+		{[]string{"--region", "eu-wset-7", "small"}, ErrInvalidChoice,
+			"option '--region' argument 'eu-wset-7' is not an allowed choice, did you mean 'eu-west-7'?"},
+		{[]string{"--region", "moon-1", "small"}, ErrInvalidChoice,
+			"option '--region' argument 'moon-1' is not an allowed choice"},
+		{[]string{"--zones", "a,d", "small"}, ErrInvalidChoice,
+			"option '--zones' argument 'd' is not an allowed choice"},
+		{[]string{"meduim"}, ErrInvalidArgument,
+			"argument 'meduim' is not an allowed choice, did you mean 'medium'?"},
+	}
+	for _, tt := range tests {
+		_, err := cmd.ParseArgs(tt.args)
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) || parseErr.Code != tt.code || err.Error() != tt.message {
+			t.Errorf("%v: got %v", tt.args, err)
+		}
+		if !errors.Is(err, errNotAChoice) {
+			t.Errorf("%v: cause %v is not errNotAChoice", tt.args, parseErr.Err)
+		}
+	}
+}
+
+func TestEncodeChoiceError(t *testing.T) {
+	root := NewCommand("app")
+	deploy, _ := newTestCommand("deploy",
+		NewOption("-v, --verbose", "Verbose output"),
+		NewOption("--size <size>", "Size").SetChoices([]string{"small", "large"}),
+	)
+	root.AddCommand(NewCommand("build"))
+	root.AddCommand(deploy)
+
+	result, err := root.ParseArgs([]string{"deploy", "--size", "lrage"})
+	out := make([]uint32, 16)
+	if status := encodeResult(out, result, err); status != uint32(ErrInvalidChoice) {
+		t.Fatalf("status = %d (%v)", status, err)
+	}
+	// path deploy, option slot 1, suggestion "large" at position 1
+	want := []uint32{uint32(ErrInvalidChoice), 7, 1, 1, 1, 2, 1}
+	for i, w := range want {
+		if out[i] != w {
+			t.Fatalf("word %d = %d, want %d (%v)", i, out[i], w, out[:len(want)])
+		}
+	}
+}
+
+func BenchmarkChoiceFind(b *testing.B) {
+	for _, n := range []int{8, 500} {
+		choices := regions(n)
+		value := choices[n*3/4]
+		b.Run(fmt.Sprintf("set/%d", n), func(b *testing.B) {
+			set := newChoiceSet(choices)
+			for i := 0; i < b.N; i++ {
+				if set.find(value) < 0 {
+					b.Fatal("not found")
+				}
+			}
+		})
+		b.Run(fmt.Sprintf("scan/%d", n), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				found := false
+				for _, choice := range choices {
+					if choice == value {
+						found = true
+						break
+					}
+				}
+				if !found {
+					b.Fatal("not found")
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkChoiceSuggest(b *testing.B) {
+	set := newChoiceSet(regions(500))
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if set.suggest("ap-nrotheast-30") < 0 {
+			b.Fatal("no suggestion")
+		}
+	}
+}
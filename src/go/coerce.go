@@ -0,0 +1,101 @@
+package main
+
+import (
+	"errors"
+	"math"
+	"strconv"
+	"strings"
+	"time"
+)
+
+// byteUnits maps the lower-cased unit suffixes ParseBytes accepts to their
+// multipliers. SI units (kB, MB, ...) are powers of 1000 and IEC units
+// (KiB, MiB, ...) powers of 1024; single letters follow the IEC units, as
+// they do for dd and most other command-line tools.
+var byteUnits = map[string]float64{
+	"":  1,
+	"b": 1,
+	"k": 1 << 10, "kb": 1e3, "kib": 1 << 10,
+	"m": 1 << 20, "mb": 1e6, "mib": 1 << 20,
+	"g": 1 << 30, "gb": 1e9, "gib": 1 << 30,
+	"t": 1 << 40, "tb": 1e12, "tib": 1 << 40,
+	"p": 1 << 50, "pb": 1e15, "pib": 1 << 50,
+}
+
+var errBadByteSize = errors.New("invalid byte size")
+
+// ParseBytes parses a byte size: a non-negative number, optionally with a
+// fractional part, followed by an optional unit such as "KiB", "MB" or
+// "G". Units are case-insensitive.
+func ParseBytes(s string) (int64, error) {
+	end := 0
+	for end < len(s) && (s[end] >= '0' && s[end] <= '9' || s[end] == '.') {
+		end++
+	}
+	if end == 0 {
+		return 0, errBadByteSize
+	}
+
+	unit := strings.TrimSpace(s[end:])
+	multiplier, ok := byteUnits[unit]
+	if !ok {
+		multiplier, ok = byteUnits[strings.ToLower(unit)]
+		if !ok {
+			return 0, errBadByteSize
+		}
+	}
+
+	if !strings.Contains(s[:end], ".") {
+		// Whole numbers stay exact beyond the 53 bits of a float64
+		n, err := strconv.ParseInt(s[:end], 10, 64)
+		if err != nil || n > math.MaxInt64/int64(multiplier) {
+			return 0, strconv.ErrRange
+		}
+		return n * int64(multiplier), nil
+	}
+
+	f, err := strconv.ParseFloat(s[:end], 64)
+	if err != nil {
+		return 0, errBadByteSize
+	}
+	f *= multiplier
+	if f >= math.MaxInt64 {
+		return 0, strconv.ErrRange
+	}
+	return int64(f), nil
+}
+
+// Coercer returns one of the built-in value conversions as a Parser for
+// arguments, or for options that need an interface{} value. Options are
+// better served by SetKind, which stores the same values without boxing
+// them. choices is only used by KindEnum.
+func Coercer(kind OptionKind, choices ...string) func(string) (interface{}, error) {
+	spec := &slotSpec{kind: kind}
+	set := newChoiceSet(choices)
+	return func(value string) (interface{}, error) {
+		switch kind {
+		case KindString, KindAuto:
+			return value, nil
+		case KindList:
+			return appendList(nil, value), nil
+		case KindStringList:
+			return []string{value}, nil
+		}
+
+		i, f, err := spec.convert(value, set)
+		if err != nil {
+			return nil, err
+		}
+		switch kind {
+		case KindBool:
+			return i != 0, nil
+		case KindFloat:
+			return f, nil
+		case KindDuration:
+			return time.Duration(i), nil
+		case KindEnum:
+			return set.values[i], nil
+		}
+		return i, nil
+	}
+}
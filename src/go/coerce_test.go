@@ -0,0 +1,186 @@
+package main
+
+import (
+	"errors"
+	"math"
+	"reflect"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+)
+
+func TestParseBytes(t *testing.T) {
+	tests := []struct {
+		in   string
+		want int64
+		err  bool
+	}{
+		{"0", 0, false},
+		{"512", 512, false},
+		{"512B", 512, false},
+		{"64MiB", 64 << 20, false},
+		{"64mib", 64 << 20, false},
+		{"64M", 64 << 20, false},
+		{"64MB", 64e6, false},
+		{"1.5GB", 1.5e9, false},
+		{"1.5 KiB", 1536, false},
+		{"8EiB", 0, true},
+		{"9223372036854775808", 0, true},
+		{"", 0, true},
+		{"MB", 0, true},
+		{"12 parsecs", 0, true},
+		{"1.2.3K", 0, true},
+	}
+	for _, tt := range tests {
+		got, err := ParseBytes(tt.in)
+		if (err != nil) != tt.err || got != tt.want {
+			t.Errorf("ParseBytes(%q) = %d, %v", tt.in, got, err)
+		}
+	}
+}
+
+func coerceTestCommand() (*Command, map[string]*Option) {
+	cmd, o := newTestCommand("app",
+		NewOption("--timeout <d>", "Timeout").SetKind(KindDuration).SetDefault("30s"),
+		NewOption("--size <n>", "Size").SetKind(KindBytes),
+		NewOption("--mode <mode>", "Mode").SetChoices([]string{"slow", "fast"}).SetDefault("slow"),
+		NewOption("--tags <list>", "Tags").SetKind(KindList),
+		NewOption("--user <name>", "User").SetParser(func(s string) (interface{}, error) {
+			if s == "" {
+				return nil, errors.New("empty user")
+			}
+			return strings.ToUpper(s), nil
+		}),
+	)
+	cmd.AddArgument(NewArgument("<port>", "Port").SetParser(Coercer(KindInt)))
+	cmd.AddArgument(NewArgument("[delays...]", "Delays").SetParser(Coercer(KindDuration)))
+	return cmd, o
+}
+
+func TestCoercedValues(t *testing.T) {
+	cmd, o := coerceTestCommand()
+	result, err := cmd.ParseArgs([]string{"--size", "64MiB", "--mode", "fast", "--tags", "a,b",
+		"--tags", "c", "--user", "ann", "8080", "1s", "2m"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.Duration(o["timeout"]) != 30*time.Second || result.Int(o["size"]) != 64<<20 ||
+		result.String(o["mode"]) != "fast" || result.Int(o["mode"]) != 1 {
+		t.Errorf("timeout %v size %d mode %q", result.Duration(o["timeout"]), result.Int(o["size"]), result.String(o["mode"]))
+	}
+	if got := result.Strings(o["tags"]); !reflect.DeepEqual(got, []string{"a", "b", "c"}) {
+		t.Errorf("tags = %v", got)
+	}
+	if got := result.Parsed(o["user"]); got != "ANN" {
+		t.Errorf("user = %v", got)
+	}
+	want := []interface{}{int64(8080), time.Second, 2 * time.Minute}
+	if !reflect.DeepEqual(result.ArgValues, want) {
+		t.Errorf("ArgValues = %v, want %v", result.ArgValues, want)
+	}
+	values := result.Values()
+	if values["timeout"] != 30*time.Second || values["mode"] != "fast" || values["user"] != "ANN" {
+		t.Errorf("Values() = %v", values)
+	}
+}
+
+func TestCoerceErrors(t *testing.T) {
+	cmd, _ := coerceTestCommand()
+	tests := []struct {
+		args  []string
+		code  ErrorCode
+		index int
+		cause error
+	}{
+		{[]string{"--timeout", "soon", "80"}, ErrInvalidOptionValue, 0, nil},
+		{[]string{"80", "--size", "9000PiB"}, ErrInvalidOptionValue, 1, strconv.ErrRange},
+		{[]string{"--mode", "medium", "80"}, ErrInvalidChoice, 0, errNotAChoice},
+		{[]string{"--user", "", "80"}, ErrInvalidOptionValue, 0, nil},
+		{[]string{"eighty"}, ErrInvalidArgument, 0, strconv.ErrSyntax},
+		{[]string{"80", "1s", "later"}, ErrInvalidArgument, 2, nil},
+	}
+	for _, tt := range tests {
+		_, err := cmd.ParseArgs(tt.args)
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) || parseErr.Code != tt.code || parseErr.Index != tt.index {
+			t.Errorf("%v: got %v (%+v)", tt.args, err, parseErr)
+			continue
+		}
+		if tt.cause != nil && !errors.Is(err, tt.cause) {
+			t.Errorf("%v: cause %v, want %v", tt.args, parseErr.Err, tt.cause)
+		}
+	}
+}
+
+func TestCoercer(t *testing.T) {
+	tests := []struct {
+		kind OptionKind
+		in   string
+		want interface{}
+	}{
+		{KindBool, "true", true},
+		{KindInt, "-0x10", int64(-16)},
+		{KindFloat, "2.5", 2.5},
+		{KindBytes, "2k", int64(2048)},
+		{KindDuration, "90s", 90 * time.Second},
+		{KindList, "a,,b", []string{"a", "", "b"}},
+		{KindString, "x", "x"},
+	}
+	for _, tt := range tests {
+		got, err := Coercer(tt.kind)(tt.in)
+		if err != nil || !reflect.DeepEqual(got, tt.want) {
+			t.Errorf("Coercer(%v)(%q) = %v, %v", tt.kind, tt.in, got, err)
+		}
+	}
+	if got, err := Coercer(KindEnum, "a", "b")("b"); got != "b" || err != nil {
+		t.Errorf("enum: %v, %v", got, err)
+	}
+	if _, err := Coercer(KindEnum, "a", "b")("c"); err == nil {
+		t.Error("enum accepted a value outside its choices")
+	}
+}
+
+// TestEncodeTypedValues pins the words the typed-values check in
+// test/advanced-test.js decodes
+func TestEncodeTypedValues(t *testing.T) {
+	cmd, _ := newTestCommand("typed-test",
+		NewOption("-v, --verbose", "Verbosity").SetKind(KindCount),
+		NewOption("--timeout <duration>", "Timeout").SetKind(KindDuration),
+		NewOption("--ratio <x>", "Ratio").SetKind(KindFloat),
+		NewOption("--mode <mode>", "Mode").SetChoices([]string{"slow", "fast"}).SetDefault("slow"),
+		NewOption("--tags <list>", "Tags").SetKind(KindList),
+	)
+
+	args := []string{"-v", "-v", "--timeout", "1500ms", "--ratio", "0.25", "--mode", "fast", "--tags", "a,b"}
+	result, err := cmd.ParseArgs(args)
+	out := make([]uint32, 64)
+	if status := encodeResult(out, result, err); status != uint32(ErrNone) {
+		t.Fatalf("status = %d (%v)", status, err)
+	}
+	ratio := math.Float64bits(0.25)
+	want := []uint32{
+		0, 30, resultNone, 0, 6, 0,
+		0, resultNone, 0, resultNone, 1, 3, 2, 5, 3, 7, 4, 9,
+		2, 0, 2, 0, 1500000000, 0, uint32(ratio), uint32(ratio >> 32), 1, 0, 0, 0,
+	}
+	if !reflect.DeepEqual(out[:len(want)], want) {
+		t.Errorf("words = %v\nwant    %v", out[:len(want)], want)
+	}
+}
+
+func BenchmarkCoercedParse(b *testing.B) {
+	cmd, o := coerceTestCommand()
+	args := []string{"--timeout", "5s", "--size", "64MiB", "--mode", "fast", "--tags", "a,b,c", "80"}
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		result, err := cmd.ParseArgsPooled(args)
+		if err != nil {
+			b.Fatal(err)
+		}
+		if result.Int(o["size"]) != 64<<20 {
+			b.Fatal("wrong value")
+		}
+		result.Release()
+	}
+}
@@ -0,0 +1,375 @@
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"hash/crc64"
+	"hash/fnv"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"sort"
+	"sync"
+)
+
+// Commands can take option defaults from a JSON config file. The file is
+// flattened into dotted keys ("server.port") mapping to the string form of
+// each value, one string per element for arrays, and options look up
+// their ConfigKey, or their name, among them.
+//
+// Parsing JSON with thousands of keys dominates the start-up of a CLI that
+// reads it on every run, so the flattened form is cached in memory for the
+// life of the process, keyed by the file's path, modification time and
+// size. A rewrite that keeps the size within the file system's timestamp
+// granularity is not noticed until the process restarts.
+//
+// Processes can also share a disk cache, a compact binary file that later
+// runs load without touching the JSON. It is off unless a directory is set
+// with SetConfigCacheDir or GOMMANDER_CONFIG_CACHE_DIR, and since it
+// outlives processes it also records a checksum of the file's content,
+// which is checked on every load.
+//
+// Both files are read with os.ReadFile rather than mapped: another process
+// may truncate them while a parse runs, which would fault on a mapping,
+// and a read costs little next to the cache it fills.
+
+var errConfigNotObject = errors.New("not a JSON object")
+
+// configValues maps flattened config keys to their values
+type configValues map[string][]string
+
+// configCacheMagic starts disk cache files
+//
+//	cache := magic path modTime:i64 size:i64 sum:u64 count:u32 entry*
+//	entry := key valueCount:u32 value*
+//
+// Integers are little-endian; strings are a uint32 byte length and bytes.
+// sum is the CRC-64 of the config file.
+const configCacheMagic = "GMC2"
+
+var configSumTable = crc64.MakeTable(crc64.ECMA)
+
+type configEntry struct {
+	modTime int64
+	size    int64
+	values  configValues
+}
+
+var (
+	// configCache maps paths to their *configEntry. Hits are lock-free so
+	// parses of a shared schema do not serialize on it; configMu only
+	// keeps two misses from loading the same file at once.
+	configMu    sync.Mutex
+	configCache sync.Map
+
+	// configCacheDir is the directory of disk cache files, "" for none.
+	// Guarded by configMu.
+	configCacheDir = os.Getenv("GOMMANDER_CONFIG_CACHE_DIR")
+)
+
+// SetConfigCacheDir turns on the disk cache of config files, kept in dir,
+// or turns it off if dir is "". Hosts that cannot call it can set the
+// GOMMANDER_CONFIG_CACHE_DIR environment variable before the process
+// starts.
+func SetConfigCacheDir(dir string) {
+	configMu.Lock()
+	configCacheDir = dir
+	configMu.Unlock()
+}
+
+// loadConfig returns the flattened values of the config file at path, or
+// nil if there is no such file. It stats the file on every call, warm
+// cache or not, so an edit is picked up by the next parse of a
+// long-running process; one stat is the price of that.
+func loadConfig(path string) (configValues, error) {
+	info, err := os.Stat(path)
+	if errors.Is(err, fs.ErrNotExist) {
+		return nil, nil
+	}
+	if err != nil {
+		return nil, err
+	}
+	modTime, size := info.ModTime().UnixNano(), info.Size()
+
+	if values, ok := cachedConfig(path, modTime, size); ok {
+		return values, nil
+	}
+
+	configMu.Lock()
+	defer configMu.Unlock()
+	if values, ok := cachedConfig(path, modTime, size); ok {
+		return values, nil
+	}
+
+	cachePath := configCachePath(path)
+	var values configValues
+	if cachePath == "" {
+		values, err = parseConfigFile(path)
+	} else {
+		values, err = loadCachedConfig(cachePath, path, modTime, size)
+	}
+	if err != nil {
+		return nil, err
+	}
+	configCache.Store(path, &configEntry{modTime: modTime, size: size, values: values})
+	return values, nil
+}
+
+// loadCachedConfig returns the values of a config file from the disk cache
+// at cachePath, or parses the file and refreshes the cache
+func loadCachedConfig(cachePath, path string, modTime, size int64) (configValues, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	if int64(len(data)) != size {
+		// Changed since the caller's stat, so not worth a cache file
+		return parseConfig(data)
+	}
+
+	sum := crc64.Checksum(data, configSumTable)
+	if values := readConfigCache(cachePath, path, modTime, size, sum); values != nil {
+		return values, nil
+	}
+	values, err := parseConfig(data)
+	if err != nil {
+		return nil, err
+	}
+	// The cache only saves time; a run that cannot write it still works
+	_ = writeConfigCache(cachePath, path, modTime, size, sum, values)
+	return values, nil
+}
+
+// cachedConfig returns the values cached in memory for a config file if
+// they are still current
+func cachedConfig(path string, modTime, size int64) (configValues, bool) {
+	if cached, ok := configCache.Load(path); ok {
+		if entry := cached.(*configEntry); entry.modTime == modTime && entry.size == size {
+			return entry.values, true
+		}
+	}
+	return nil, false
+}
+
+// configCachePath returns where the disk cache of a config file lives, or
+// "" if the disk cache is off. The caller holds configMu.
+func configCachePath(path string) string {
+	dir := configCacheDir
+	if dir == "" {
+		return ""
+	}
+	if abs, err := filepath.Abs(path); err == nil {
+		path = abs
+	}
+	h := fnv.New64a()
+	h.Write([]byte(path))
+	return filepath.Join(dir, fmt.Sprintf("%016x.gmc", h.Sum64()))
+}
+
+func parseConfigFile(path string) (configValues, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	return parseConfig(data)
+}
+
+func parseConfig(data []byte) (configValues, error) {
+	decoder := json.NewDecoder(bytes.NewReader(data))
+	decoder.UseNumber()
+	var root interface{}
+	if err := decoder.Decode(&root); err != nil {
+		return nil, err
+	}
+	object, ok := root.(map[string]interface{})
+	if !ok {
+		return nil, errConfigNotObject
+	}
+	values := make(configValues)
+	flattenConfig(values, "", object)
+	return values, nil
+}
+
+// flattenConfig adds the leaves of object to values under dotted keys
+func flattenConfig(values configValues, prefix string, object map[string]interface{}) {
+	for key, value := range object {
+		if prefix != "" {
+			key = prefix + "." + key
+		}
+		switch value := value.(type) {
+		case map[string]interface{}:
+			flattenConfig(values, key, value)
+		case []interface{}:
+			items := make([]string, 0, len(value))
+			for _, item := range value {
+				if s, ok := configString(item); ok {
+					items = append(items, s)
+				}
+			}
+			values[key] = items
+		default:
+			if s, ok := configString(value); ok {
+				values[key] = []string{s}
+			}
+		}
+	}
+}
+
+// configString returns the command-line form of a scalar JSON value
+func configString(value interface{}) (string, bool) {
+	switch value := value.(type) {
+	case string:
+		return value, true
+	case json.Number:
+		return value.String(), true
+	case bool:
+		if value {
+			return "true", true
+		}
+		return "false", true
+	}
+	return "", false
+}
+
+// readConfigCache loads the disk cache at cachePath if it describes the
+// given version of the config file, and returns nil otherwise
+func readConfigCache(cachePath, path string, modTime, size int64, sum uint64) configValues {
+	if cachePath == "" {
+		return nil
+	}
+	data, err := os.ReadFile(cachePath)
+	if err != nil {
+		return nil
+	}
+
+	// Keys and values are substrings of the one buffer read
+	blob := view(data)
+	r := &schemaReader{data: data}
+	if len(blob) < len(configCacheMagic) || blob[:len(configCacheMagic)] != configCacheMagic {
+		return nil
+	}
+	r.pos = len(configCacheMagic)
+	str := func() (string, bool) {
+		n, err := r.u32()
+		if err != nil || uint64(r.pos)+uint64(n) > uint64(len(blob)) {
+			return "", false
+		}
+		s := blob[r.pos : r.pos+int(n)]
+		r.pos += int(n)
+		return s, true
+	}
+	i64 := func() (int64, bool) {
+		if r.pos+8 > len(blob) {
+			return 0, false
+		}
+		v := int64(binary.LittleEndian.Uint64(r.data[r.pos:]))
+		r.pos += 8
+		return v, true
+	}
+
+	cachedPath, ok := str()
+	cachedModTime, ok2 := i64()
+	cachedSize, ok3 := i64()
+	cachedSum, ok4 := i64()
+	count, err := r.u32()
+	if !ok || !ok2 || !ok3 || !ok4 || err != nil || cachedPath != path ||
+		cachedModTime != modTime || cachedSize != size || uint64(cachedSum) != sum {
+		return nil
+	}
+	if uint64(count)*8 > uint64(len(blob)-r.pos) {
+		return nil
+	}
+	values := make(configValues, count)
+	// Values of all keys share slabs rather than each getting a slice
+	slab := make([]string, 0, count)
+	for i := uint32(0); i < count; i++ {
+		key, ok := str()
+		n, err := r.u32()
+		if !ok || err != nil || uint64(n)*4 > uint64(len(blob)-r.pos) {
+			return nil
+		}
+		start := len(slab)
+		for j := uint32(0); j < n; j++ {
+			value, ok := str()
+			if !ok {
+				return nil
+			}
+			if len(slab) == cap(slab) {
+				// Earlier keys keep the old slab
+				slab = append(make([]string, 0, 2*cap(slab)+int(n)), slab[start:]...)
+				start = 0
+			}
+			slab = append(slab, value)
+		}
+		values[key] = slab[start:len(slab):len(slab)]
+	}
+	if r.pos != len(blob) {
+		return nil
+	}
+	return values
+}
+
+// writeConfigCache stores values in the disk cache, replacing any older
+// cache of the file in one rename so readers never see a partial file
+func writeConfigCache(cachePath, path string, modTime, size int64, sum uint64, values configValues) error {
+	if cachePath == "" {
+		return nil
+	}
+	w := &schemaWriter{buf: []byte(configCacheMagic)}
+	w.str(path)
+	w.i64(modTime)
+	w.i64(size)
+	w.i64(int64(sum))
+	w.u32(uint32(len(values)))
+	keys := make([]string, 0, len(values))
+	for key := range values {
+		keys = append(keys, key)
+	}
+	sort.Strings(keys)
+	for _, key := range keys {
+		w.str(key)
+		w.u32(uint32(len(values[key])))
+		for _, value := range values[key] {
+			w.str(value)
+		}
+	}
+
+	if err := os.MkdirAll(filepath.Dir(cachePath), 0o755); err != nil {
+		return err
+	}
+	tmp, err := os.CreateTemp(filepath.Dir(cachePath), "*.tmp")
+	if err != nil {
+		return err
+	}
+	_, err = tmp.Write(w.buf)
+	if closeErr := tmp.Close(); err == nil {
+		err = closeErr
+	}
+	if err == nil {
+		err = os.Rename(tmp.Name(), cachePath)
+	}
+	if err != nil {
+		os.Remove(tmp.Name())
+	}
+	return err
+}
+
+// schemaWriter builds little-endian binary records, the counterpart of
+// schemaReader
+type schemaWriter struct {
+	buf []byte
+}
+
+func (w *schemaWriter) u8(v byte) { w.buf = append(w.buf, v) }
+
+func (w *schemaWriter) u32(v uint32) { w.buf = binary.LittleEndian.AppendUint32(w.buf, v) }
+
+func (w *schemaWriter) i64(v int64) { w.buf = binary.LittleEndian.AppendUint64(w.buf, uint64(v)) }
+
+func (w *schemaWriter) str(s string) {
+	w.u32(uint32(len(s)))
+	w.buf = append(w.buf, s...)
+}
@@ -0,0 +1,333 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"hash/crc64"
+	"os"
+	"path/filepath"
+	"reflect"
+	"strings"
+	"testing"
+	"time"
+	"unsafe"
+)
+
+// useConfigCacheDir points the disk cache at a fresh directory and empties
+// the in-process cache for the rest of the test
+func useConfigCacheDir(t testing.TB) string {
+	dir := t.TempDir()
+	saved := configCacheDir
+	SetConfigCacheDir(dir)
+	resetConfigCache()
+	t.Cleanup(func() {
+		SetConfigCacheDir(saved)
+		resetConfigCache()
+	})
+	return dir
+}
+
+// configSum returns the checksum the disk cache records for a config file
+func configSum(t testing.TB, path string) uint64 {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	return crc64.Checksum(data, configSumTable)
+}
+
+func resetConfigCache() {
+	configCache.Range(func(path, _ interface{}) bool {
+		configCache.Delete(path)
+		return true
+	})
+}
+
+func writeConfig(t testing.TB, path, content string) {
+	if err := os.WriteFile(path, []byte(content), 0o644); err != nil {
+		t.Fatal(err)
+	}
+}
+
+const testConfig = `{
+	"host": "config.example.com",
+	"port": 7000,
+	"tags": ["a", "b"],
+	"deploy": {"region": "eu-west-1", "retries": 3, "verbose": true}
+}`
+
+func configTestCommand(path string) (*Command, map[string]*Option) {
+	root, o := newTestCommand("app",
+		NewOption("--host <host>", "Host").SetEnvVar("GOMMANDER_TEST_HOST").SetDefault("localhost"),
+		NewOption("-p, --port <n>", "Port").SetKind(KindInt).SetDefault(80),
+		NewOption("--tags <tag>", "Tags").SetKind(KindStringList),
+	)
+	root.SetConfigFile(path)
+	deploy := NewCommand("deploy")
+	for name, opt := range declareOptions(deploy,
+		NewOption("--region <region>", "Region").SetConfigKey("deploy.region"),
+		NewOption("--retries <n>", "Retries").SetKind(KindCount).SetConfigKey("deploy.retries"),
+		NewOption("--verbose", "Verbose output").SetConfigKey("deploy.verbose"),
+	) {
+		o[name] = opt
+	}
+	root.AddCommand(deploy)
+	return root, o
+}
+
+func TestConfigDefaults(t *testing.T) {
+	useConfigCacheDir(t)
+	path := filepath.Join(t.TempDir(), "app.json")
+	writeConfig(t, path, testConfig)
+	root, o := configTestCommand(path)
+	t.Setenv("GOMMANDER_TEST_HOST", "env.example.com")
+
+	// The command line beats the environment, which beats the config file
+	result, err := root.ParseArgs([]string{"--port", "9000"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.Int(o["port"]) != 9000 || result.String(o["host"]) != "env.example.com" ||
+		!reflect.DeepEqual(result.Strings(o["tags"]), []string{"a", "b"}) {
+		t.Errorf("port %d host %q tags %v", result.Int(o["port"]), result.String(o["host"]), result.Strings(o["tags"]))
+	}
+	if set := result.Set[len(result.Set)-1]; set.Option != o["tags"] || set.Index != IndexConfig {
+		t.Errorf("last set %+v", set)
+	}
+
+	// Subcommands share the file of their ancestor and find nested keys
+	result, err = root.ParseArgs([]string{"deploy"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.String(o["region"]) != "eu-west-1" || result.Int(o["retries"]) != 3 || !result.Bool(o["verbose"]) {
+		t.Errorf("region %q retries %d verbose %v", result.String(o["region"]), result.Int(o["retries"]), result.Bool(o["verbose"]))
+	}
+	if result.Options["region"] != "eu-west-1" {
+		t.Errorf("Options = %v", result.Options)
+	}
+}
+
+func TestConfigMissingFile(t *testing.T) {
+	useConfigCacheDir(t)
+	root, o := configTestCommand(filepath.Join(t.TempDir(), "missing.json"))
+	result, err := root.ParseArgs(nil)
+	if err != nil || result.Int(o["port"]) != 80 || len(result.Set) != 0 {
+		t.Errorf("%v, port %d", err, result.Int(o["port"]))
+	}
+}
+
+func TestConfigErrors(t *testing.T) {
+	useConfigCacheDir(t)
+	dir := t.TempDir()
+
+	path := filepath.Join(dir, "broken.json")
+	writeConfig(t, path, `{"port": `)
+	root, _ := configTestCommand(path)
+	_, err := root.ParseArgs(nil)
+	var parseErr *ParseError
+	if !errors.As(err, &parseErr) || parseErr.Code != ErrConfig || parseErr.Token != path {
+		t.Errorf("malformed file: %v", err)
+	}
+	// The cause follows the path, for hosts to show
+	out := make([]uint32, 32)
+	encodeResult(out, nil, err)
+	if out[1] != resultHeaderWords {
+		t.Errorf("words %v without a result", out[:out[1]])
+	}
+	result, err := root.ParseArgs(nil)
+	encodeResult(out, result, err)
+	if cause := strings.TrimRight(string(wordBytes(out[resultHeaderWords:out[1]])), "\x00"); cause != "unexpected EOF" {
+		t.Errorf("cause %q", cause)
+	}
+
+	path = filepath.Join(dir, "invalid.json")
+	writeConfig(t, path, `{"port": "eighty"}`)
+	root, _ = configTestCommand(path)
+	result, err = root.ParseArgs(nil)
+	want := "option '--port' argument 'eighty' is invalid (from config key port)"
+	if !errors.As(err, &parseErr) || parseErr.Code != ErrInvalidOptionValue || err.Error() != want {
+		t.Fatalf("invalid value: %v", err)
+	}
+	encodeResult(out, result, err)
+	if out[2] != resultConfig || out[1] != resultHeaderWords+2 ||
+		string(wordBytes(out[resultHeaderWords:out[1]])) != "eighty\x00\x00" {
+		t.Errorf("words %v", out[:out[1]])
+	}
+}
+
+func wordBytes(words []uint32) []byte {
+	return unsafe.Slice((*byte)(unsafe.Pointer(&words[0])), 4*len(words))
+}
+
+// TestEncodeConfigValues pins the words the config check in
+// test/advanced-test.js decodes
+func TestEncodeConfigValues(t *testing.T) {
+	useConfigCacheDir(t)
+	path := filepath.Join(t.TempDir(), "app.json")
+	writeConfig(t, path, `{"host": "db1", "port": 7000, "tags": ["a", "bc"]}`)
+	root, _ := configTestCommand(path)
+	result, err := root.ParseArgs(nil)
+	out := make([]uint32, 64)
+	if status := encodeResult(out, result, err); status != uint32(ErrNone) {
+		t.Fatalf("status = %d (%v)", status, err)
+	}
+	want := []uint32{
+		0, 20, resultNone, 0, 3, 0,
+		0, resultConfig, 1, resultConfig, 2, resultConfig,
+		18, 3, 7000, 0, 19, 4,
+	}
+	if !reflect.DeepEqual(out[:len(want)], want) {
+		t.Fatalf("words = %v\nwant    %v", out[:len(want)], want)
+	}
+	if text := string(wordBytes(out[18:20])); text != "db1\x00a\x00bc" {
+		t.Errorf("text %q", text)
+	}
+	if resultWords(result) != 20 {
+		t.Errorf("resultWords = %d", resultWords(result))
+	}
+}
+
+func TestConfigCache(t *testing.T) {
+	cacheDir := useConfigCacheDir(t)
+	path := filepath.Join(t.TempDir(), "app.json")
+	writeConfig(t, path, testConfig)
+
+	first, err := loadConfig(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := os.Stat(configCachePath(path)); err != nil || filepath.Dir(configCachePath(path)) != cacheDir {
+		t.Fatalf("disk cache not written: %v", err)
+	}
+
+	// A new process has only the disk cache
+	resetConfigCache()
+	info, _ := os.Stat(path)
+	sum := configSum(t, path)
+	cached := readConfigCache(configCachePath(path), path, info.ModTime().UnixNano(), info.Size(), sum)
+	if !reflect.DeepEqual(cached, first) || len(cached) != 6 {
+		t.Fatalf("disk cache %v, want %v", cached, first)
+	}
+	if again, err := loadConfig(path); err != nil || !reflect.DeepEqual(again, first) {
+		t.Fatalf("reload: %v %v", again, err)
+	}
+
+	// Other versions of the file miss both caches
+	if readConfigCache(configCachePath(path), path, info.ModTime().UnixNano(), info.Size()+1, sum) != nil {
+		t.Error("disk cache matched another size")
+	}
+	if readConfigCache(configCachePath(path), path, info.ModTime().UnixNano(), info.Size(), sum+1) != nil {
+		t.Error("disk cache matched other content")
+	}
+	writeConfig(t, path, `{"port": 7001}`)
+	later := info.ModTime().Add(time.Second)
+	if err := os.Chtimes(path, later, later); err != nil {
+		t.Fatal(err)
+	}
+	values, err := loadConfig(path)
+	if err != nil || !reflect.DeepEqual(values, configValues{"port": {"7001"}}) {
+		t.Errorf("after edit: %v %v", values, err)
+	}
+
+	// A damaged cache is ignored, then replaced
+	if err := os.WriteFile(configCachePath(path), []byte(configCacheMagic+"garbage"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	resetConfigCache()
+	if values, err := loadConfig(path); err != nil || values["port"][0] != "7001" {
+		t.Errorf("damaged cache: %v %v", values, err)
+	}
+}
+
+// A rewrite that keeps the size and modification time still misses the
+// disk cache of another process
+func TestConfigCacheContent(t *testing.T) {
+	useConfigCacheDir(t)
+	path := filepath.Join(t.TempDir(), "app.json")
+	writeConfig(t, path, `{"port": 7001}`)
+	info, _ := os.Stat(path)
+	if _, err := loadConfig(path); err != nil {
+		t.Fatal(err)
+	}
+
+	writeConfig(t, path, `{"port": 7002}`)
+	if err := os.Chtimes(path, info.ModTime(), info.ModTime()); err != nil {
+		t.Fatal(err)
+	}
+	resetConfigCache()
+	values, err := loadConfig(path)
+	if err != nil || !reflect.DeepEqual(values, configValues{"port": {"7002"}}) {
+		t.Errorf("after same-size edit: %v %v", values, err)
+	}
+}
+
+func TestConfigCacheOff(t *testing.T) {
+	cacheDir := useConfigCacheDir(t)
+	SetConfigCacheDir("")
+	path := filepath.Join(t.TempDir(), "app.json")
+	writeConfig(t, path, testConfig)
+	if values, err := loadConfig(path); err != nil || len(values) != 6 {
+		t.Fatalf("%v %v", values, err)
+	}
+	if files, _ := os.ReadDir(cacheDir); configCachePath(path) != "" || len(files) != 0 {
+		t.Errorf("disk cache written with no directory set: %v", files)
+	}
+}
+
+// largeConfig returns a config file with n keys spread over sections
+func largeConfig(n int) string {
+	var b strings.Builder
+	b.WriteString("{")
+	for section := 0; section*100 < n; section++ {
+		if section > 0 {
+			b.WriteString(",")
+		}
+		fmt.Fprintf(&b, "%q: {", fmt.Sprintf("section%d", section))
+		for i := section * 100; i < n && i < (section+1)*100; i++ {
+			if i > section*100 {
+				b.WriteString(",")
+			}
+			fmt.Fprintf(&b, `"key%d": {"value": "value number %d", "limit": %d, "tags": ["x", "y"]}`, i, i, i*7)
+		}
+		b.WriteString("}")
+	}
+	b.WriteString("}")
+	return b.String()
+}
+
+func BenchmarkConfigLoad(b *testing.B) {
+	useConfigCacheDir(b)
+	path := filepath.Join(b.TempDir(), "big.json")
+	writeConfig(b, path, largeConfig(5000))
+	info, _ := os.Stat(path)
+	modTime, size, sum := info.ModTime().UnixNano(), info.Size(), configSum(b, path)
+	if _, err := loadConfig(path); err != nil {
+		b.Fatal(err)
+	}
+
+	b.Run("json", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if _, err := parseConfigFile(path); err != nil {
+				b.Fatal(err)
+			}
+		}
+	})
+	b.Run("disk-cache", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if readConfigCache(configCachePath(path), path, modTime, size, sum) == nil {
+				b.Fatal("cache miss")
+			}
+		}
+	})
+	b.Run("process-cache", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if _, err := loadConfig(path); err != nil {
+				b.Fatal(err)
+			}
+		}
+	})
+}
@@ -0,0 +1,43 @@
+package main
+
+/*
+#include <stdint.h>
+
+// Host callback that runs the action registered for a command. ctx is the
+// opaque value the host passed to ParseInto; words/count is the packed
+// parse result (see result.go), only valid for the duration of the call.
+typedef void (*gommander_dispatch_fn)(uintptr_t ctx, uint32_t action, uint32_t* words, int count);
+
+static void gommander_dispatch(void* fn, uintptr_t ctx, uint32_t action, uint32_t* words, int count) {
+	((gommander_dispatch_fn)fn)(ctx, action, words, count);
+}
+*/
+import "C"
+
+import (
+	"sync/atomic"
+	"unsafe"
+)
+
+// dispatchCallback holds the host callback set through SetDispatchCallback
+var dispatchCallback atomic.Pointer[byte]
+
+// setDispatchCallback installs the host callback used to run actions that
+// live outside Go
+func setDispatchCallback(fn unsafe.Pointer) {
+	dispatchCallback.Store((*byte)(fn))
+}
+
+// dispatchAction hands a successful parse to the host action registered for
+// the matched command. It may be called from any thread or goroutine; the
+// host decides how to get back to its own event loop.
+func dispatchAction(ctx uintptr, result *ParseResult, words []uint32) bool {
+	fn := dispatchCallback.Load()
+	if fn == nil || ctx == 0 || result.Command.ActionID == 0 || len(words) == 0 {
+		return false
+	}
+
+	C.gommander_dispatch(unsafe.Pointer(fn), C.uintptr_t(ctx), C.uint32_t(result.Command.ActionID),
+		(*C.uint32_t)(unsafe.Pointer(&words[0])), C.int(words[1]))
+	return true
+}
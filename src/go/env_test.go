@@ -0,0 +1,191 @@
+package main
+
+import (
+	"errors"
+	"reflect"
+	"testing"
+	"unsafe"
+)
+
+func envTestCommand() (*Command, map[string]*Option) {
+	root, o := newTestCommand("app",
+		NewOption("--host <host>", "Host").SetEnvVar("GOMMANDER_TEST_HOST").SetDefault("localhost"),
+		NewOption("-p, --port <n>", "Port").SetKind(KindInt).SetEnvVar("GOMMANDER_TEST_PORT").SetDefault(80),
+		NewOption("--debug", "Debug output").SetEnvVar("GOMMANDER_TEST_DEBUG"),
+	)
+	root.AddCommand(NewCommand("status"))
+	return root, o
+}
+
+func TestEnvFallback(t *testing.T) {
+	root, o := envTestCommand()
+	host, port, debug := o["host"], o["port"], o["debug"]
+	t.Setenv("GOMMANDER_TEST_HOST", "example.com")
+	t.Setenv("GOMMANDER_TEST_PORT", "8080")
+	t.Setenv("GOMMANDER_TEST_DEBUG", "true")
+
+	// The command line beats the environment, which beats defaults
+	result, err := root.ParseArgs([]string{"--port", "9000"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.Int(port) != 9000 || result.String(host) != "example.com" || !result.Bool(debug) {
+		t.Errorf("port %d host %q debug %v", result.Int(port), result.String(host), result.Bool(debug))
+	}
+	want := map[string]interface{}{"host": "example.com", "port": int64(9000), "debug": true}
+	for name, value := range want {
+		if result.Options[name] != value {
+			t.Errorf("Options[%q] = %v, want %v", name, result.Options[name], value)
+		}
+	}
+	envSet := 0
+	for _, set := range result.Set {
+		if set.Index == IndexEnv {
+			envSet++
+		}
+	}
+	if envSet != 2 {
+		t.Errorf("%d options set from the environment, want 2", envSet)
+	}
+
+	// Options of commands that were not matched are not looked up
+	result, err = root.ParseArgs([]string{"status"})
+	if err != nil || len(result.Set) != 0 {
+		t.Errorf("status: %v, %d options set", err, len(result.Set))
+	}
+}
+
+func TestEnvFallbackUnset(t *testing.T) {
+	root, o := envTestCommand()
+	host, port, debug := o["host"], o["port"], o["debug"]
+	t.Setenv("GOMMANDER_TEST_DEBUG", "0")
+	result, err := root.ParseArgs(nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.IsSet(host) || result.String(host) != "localhost" || result.Int(port) != 80 {
+		t.Errorf("host %q port %d", result.String(host), result.Int(port))
+	}
+	if !result.IsSet(debug) || result.Bool(debug) {
+		t.Error("debug should be set to false from the environment")
+	}
+}
+
+func TestEnvInvalidValue(t *testing.T) {
+	root, _ := envTestCommand()
+	t.Setenv("GOMMANDER_TEST_PORT", "eighty")
+	result, err := root.ParseArgs(nil)
+
+	var parseErr *ParseError
+	if !errors.As(err, &parseErr) || parseErr.Code != ErrInvalidOptionValue || parseErr.Index != -1 {
+		t.Fatalf("got %v", err)
+	}
+	want := "option '--port' argument 'eighty' is invalid (from environment variable GOMMANDER_TEST_PORT)"
+	if err.Error() != want {
+		t.Errorf("message %q", err.Error())
+	}
+
+	// The rejected text follows the path, so hosts need not read the
+	// variable themselves
+	out := make([]uint32, 16)
+	text := []uint32{'e' | 'i'<<8 | 'g'<<16 | 'h'<<24, 't' | 'y'<<8}
+	if status := encodeResult(out, result, err); status != uint32(ErrInvalidOptionValue) ||
+		out[1] != 8 || out[2] != resultEnv || out[4] != 1 || !reflect.DeepEqual(out[6:8], text) {
+		t.Errorf("words %v", out[:8])
+	}
+}
+
+// Parses through ParseInto look variables up in the environment the host
+// passed, not in the Go runtime's copy
+func TestHostEnv(t *testing.T) {
+	root, o := envTestCommand()
+	t.Setenv("GOMMANDER_TEST_HOST", "go.example.com")
+	t.Setenv("GOMMANDER_TEST_PORT", "1")
+
+	handle := registerCommand(0, root)
+	defer destroyCommand(handle)
+	blob := []byte("GOMMANDER_TEST_HOSTNAME=x" + "GOMMANDER_TEST_HOST=host.example.com")
+	offsets := []uint32{0, 25, uint32(len(blob))}
+	words := make([]uint32, 32)
+	status := parseArena(handle, nil, nil, hostEnv{blob: unsafe.Pointer(&blob[0]), offsets: offsets}, words, 0)
+	if status != uint32(ErrNone) {
+		t.Fatalf("status %d", status)
+	}
+
+	// host from the host's environment as text, port left to its default
+	// since the host has no GOMMANDER_TEST_PORT
+	want := []uint32{
+		0, 14, resultNone, 0, 1, 0,
+		uint32(o["host"].Slot), resultEnv,
+		10, 16,
+		'h' | 'o'<<8 | 's'<<16 | 't'<<24, '.' | 'e'<<8 | 'x'<<16 | 'a'<<24,
+		'm' | 'p'<<8 | 'l'<<16 | 'e'<<24, '.' | 'c'<<8 | 'o'<<16 | 'm'<<24,
+	}
+	if !reflect.DeepEqual(words[:len(want)], want) {
+		t.Errorf("words = %v\nwant    %v", words[:len(want)], want)
+	}
+}
+
+// Host environments are indexed once per parse; later parses of a pooled
+// result neither allocate nor see an earlier parse's variables
+func TestHostEnvReuse(t *testing.T) {
+	if raceEnabled {
+		t.Skip("sync.Pool drops items under the race detector")
+	}
+	root, _ := envTestCommand()
+	handle := registerCommand(0, root)
+	defer destroyCommand(handle)
+	words := make([]uint32, 32)
+	arena := func(environ string) hostEnv {
+		blob := []byte(environ)
+		return hostEnv{blob: unsafe.Pointer(&blob[0]), offsets: []uint32{0, uint32(len(blob))}}
+	}
+
+	if status := parseArena(handle, nil, nil, arena("GOMMANDER_TEST_PORT=eighty"), words, 0); status != uint32(ErrInvalidOptionValue) {
+		t.Fatalf("status %d", status)
+	}
+	env := arena("GOMMANDER_TEST_HOSTNAME=x")
+	allocs := testing.AllocsPerRun(100, func() {
+		if status := parseArena(handle, nil, nil, env, words, 0); status != uint32(ErrNone) || words[4] != 0 {
+			t.Fatalf("status %d, %d options set", status, words[4])
+		}
+	})
+	if allocs != 0 {
+		t.Errorf("%v allocations per parse with a host environment", allocs)
+	}
+}
+
+func TestEnvParseAllocations(t *testing.T) {
+	if raceEnabled {
+		t.Skip("sync.Pool drops items under the race detector")
+	}
+	root, o := envTestCommand()
+	port := o["port"]
+	t.Setenv("GOMMANDER_TEST_PORT", "8080")
+	t.Setenv("GOMMANDER_TEST_HOST", "example.com")
+	allocs := testing.AllocsPerRun(100, func() {
+		result, err := root.ParseArgsPooled(nil)
+		if err != nil || result.Int(port) != 8080 {
+			t.Fatal(err)
+		}
+		result.Release()
+	})
+	if allocs != 0 {
+		t.Errorf("%v allocations per parse with environment fallback", allocs)
+	}
+}
+
+func BenchmarkEnvFallback(b *testing.B) {
+	root, o := envTestCommand()
+	port := o["port"]
+	b.Setenv("GOMMANDER_TEST_PORT", "8080")
+	b.Setenv("GOMMANDER_TEST_HOST", "example.com")
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		result, err := root.ParseArgsPooled(nil)
+		if err != nil || result.Int(port) != 8080 {
+			b.Fatal(err)
+		}
+		result.Release()
+	}
+}
@@ -0,0 +1,221 @@
+package main
+
+import "fmt"
+
+// A frozen command tree is an immutable snapshot of a schema. Freeze
+// copies the commands, options and arguments of a tree and compiles the
+// copy once, so parsing it only reads memory nothing else writes: any
+// number of goroutines or host threads can parse one snapshot at the same
+// time without locks while the original tree keeps being edited.
+//
+// Command methods that modify a frozen command panic. Options and
+// arguments of a snapshot are its own copies and must not be modified
+// either; parser functions and default values are shared with the
+// original tree.
+//
+// Frozen commands keep no indexes of their own: FindOption and
+// FindCommand look flags and names up in the program compiled for the
+// whole snapshot, whose tables the garbage collector does not scan (see
+// layout.go), and a subcommand parses with that program from its own
+// state.
+//
+// The copied tree itself has to stay: results point to its commands and
+// options, and callers walk Commands and Options as on any tree. Its
+// nodes and the lists naming them are carved out of one slab per type
+// instead, so a snapshot is a handful of heap objects whatever its size.
+// Holding on to any command or option of a snapshot keeps all of it.
+
+// Freeze returns a frozen snapshot of the tree below c, with c as its
+// root. A snapshot has no parent even if c has one. Freezing a frozen
+// command returns it unchanged.
+func (c *Command) Freeze() *Command {
+	if c.frozen != nil {
+		return c
+	}
+	var size snapshotSize
+	size.measure(c)
+	snapshot := newSnapshotSlabs(size).snapshot(c, nil)
+	snapshot.freeze()
+	return snapshot
+}
+
+// Frozen reports whether c is part of a snapshot made by Freeze
+func (c *Command) Frozen() bool {
+	return c.frozen != nil
+}
+
+// snapshotSlabs holds every node of a snapshot and the lists naming
+// them. The slabs are sized up front from a snapshotSize, so handing out
+// parts of them never moves what was handed out before.
+type snapshotSlabs struct {
+	commands     []Command
+	options      []Option
+	arguments    []Argument
+	commandList  []*Command
+	optionList   []*Option
+	argumentList []*Argument
+	strings      []string // aliases and choices
+}
+
+// snapshotSize counts the nodes and list entries of a tree
+type snapshotSize struct {
+	commands, subcommands, options, arguments, strings int
+}
+
+// measure adds what the tree below c takes
+func (n *snapshotSize) measure(c *Command) {
+	n.commands++
+	n.subcommands += len(c.Commands)
+	n.options += len(c.Options)
+	n.arguments += len(c.Arguments)
+	n.strings += len(c.Aliases)
+	for _, opt := range c.Options {
+		n.strings += len(opt.Choices)
+	}
+	for _, arg := range c.Arguments {
+		n.strings += len(arg.Choices)
+	}
+	for _, child := range c.Commands {
+		n.measure(child)
+	}
+}
+
+// newSnapshotSlabs returns empty slabs for a tree of the given size
+func newSnapshotSlabs(n snapshotSize) *snapshotSlabs {
+	return &snapshotSlabs{
+		commands:     make([]Command, 0, n.commands),
+		options:      make([]Option, 0, n.options),
+		arguments:    make([]Argument, 0, n.arguments),
+		commandList:  make([]*Command, 0, n.subcommands),
+		optionList:   make([]*Option, 0, n.options),
+		argumentList: make([]*Argument, 0, n.arguments),
+		strings:      make([]string, 0, n.strings),
+	}
+}
+
+// take extends a slab by n zero elements and returns them, capped so
+// appending to them cannot write into the rest of the slab
+func take[T any](slab *[]T, n int) []T {
+	start := len(*slab)
+	*slab = (*slab)[:start+n]
+	return (*slab)[start : start+n : start+n]
+}
+
+// copyStrings returns a copy of list in the strings slab, nil if empty
+func (s *snapshotSlabs) copyStrings(list []string) []string {
+	if len(list) == 0 {
+		return nil
+	}
+	out := take(&s.strings, len(list))
+	copy(out, list)
+	return out
+}
+
+// snapshot copies the tree below c under parent into the slabs
+func (s *snapshotSlabs) snapshot(c *Command, parent *Command) *Command {
+	cmd := &take(&s.commands, 1)[0]
+	*cmd = Command{
+		Name:               c.Name,
+		Description:        c.Description,
+		Version:            c.Version,
+		Commands:           take(&s.commandList, len(c.Commands)),
+		Options:            take(&s.optionList, len(c.Options)),
+		Arguments:          take(&s.argumentList, len(c.Arguments)),
+		Action:             c.Action,
+		Parent:             parent,
+		AllowUnknown:       c.AllowUnknown,
+		Aliases:            s.copyStrings(c.Aliases),
+		NumSlots:           c.NumSlots,
+		ActionID:           c.ActionID,
+		ConfigFile:         c.ConfigFile,
+		AbbreviateCommands: c.AbbreviateCommands,
+		ResponseFiles:      c.ResponseFiles,
+	}
+
+	options := take(&s.options, len(c.Options))
+	for i, opt := range c.Options {
+		options[i] = *opt
+		options[i].Choices = s.copyStrings(opt.Choices)
+		cmd.Options[i] = &options[i]
+		if opt == c.HelpOption {
+			cmd.HelpOption = &options[i]
+		}
+	}
+	arguments := take(&s.arguments, len(c.Arguments))
+	for i, arg := range c.Arguments {
+		arguments[i] = *arg
+		arguments[i].Choices = s.copyStrings(arg.Choices)
+		cmd.Arguments[i] = &arguments[i]
+	}
+	for i, child := range c.Commands {
+		cmd.Commands[i] = s.snapshot(child, cmd)
+	}
+	// Only compiling abbreviations needs the index
+	if cmd.AbbreviateCommands {
+		cmd.reindexCommands()
+	}
+	return cmd
+}
+
+// freeze compiles the tree below c and marks it frozen, dropping the
+// indexes of its commands. The tree must not be reachable from anything
+// that could still modify it.
+func (c *Command) freeze() {
+	p := c.Compile()
+	for state, cmd := range p.commands {
+		cmd.frozen = p
+		cmd.state = int32(state)
+		cmd.optionIndex = nil
+		cmd.commandIndex = commandTrie{}
+	}
+}
+
+// frozenProgram returns the program of the snapshot c belongs to, rooted
+// at c
+func (c *Command) frozenProgram() *Program {
+	if c.state == 0 {
+		return c.frozen
+	}
+	p := *c.frozen
+	p.start = c.state
+	p.responseFiles = c.ResponseFiles
+	return &p
+}
+
+// findOption returns the option of a frozen command holding flag: the
+// first declared with it, as the index of a mutable command has it
+func (c *Command) findOption(flag string) *Option {
+	p := c.frozen
+	t, found := p.lookup(&p.states[c.state], entryToken, flag)
+	switch {
+	case !found || t.kind == transitionEnter:
+		return nil
+	case t.kind == transitionFlag || t.kind == transitionValue:
+		return p.options[t.target]
+	}
+	// Help and version tokens hide the options behind them
+	for _, opt := range c.Options {
+		if opt.ShortFlag == flag || opt.LongFlag == flag {
+			return opt
+		}
+	}
+	return nil
+}
+
+// findCommand returns the subcommand of a frozen command that name
+// selects, or nil
+func (c *Command) findCommand(name string) *Command {
+	p := c.frozen
+	if t, found := p.lookup(&p.states[c.state], entryToken, name); found && t.kind == transitionEnter {
+		return p.commands[t.target]
+	}
+	return nil
+}
+
+// mutable panics if c is frozen; every method that modifies a command
+// calls it first
+func (c *Command) mutable() {
+	if c.frozen != nil {
+		panic(fmt.Sprintf("gommander: command '%s' is frozen", c.Name))
+	}
+}
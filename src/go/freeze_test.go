@@ -0,0 +1,190 @@
+package main
+
+import (
+	"fmt"
+	"reflect"
+	"sync"
+	"testing"
+)
+
+func TestFreezeSnapshot(t *testing.T) {
+	root := programTestCommand()
+	frozen := root.Freeze()
+	if !frozen.Frozen() || root.Frozen() || frozen.Freeze() != frozen {
+		t.Fatal("Freeze did not make a separate frozen tree")
+	}
+
+	// Editing the original leaves the snapshot as it was
+	root.FindCommand("serve").AddOption(NewOption("--tls", "TLS"))
+	root.AddCommand(NewCommand("extra"))
+	if _, err := frozen.ParseArgs([]string{"serve", "--tls", "public"}); err == nil {
+		t.Error("snapshot picked up an option added afterwards")
+	}
+	if frozen.FindCommand("extra") != nil {
+		t.Error("snapshot picked up a command added afterwards")
+	}
+
+	result, err := frozen.ParseArgs([]string{"-c", "x.json", "s", "--port", "80", "public", "-v"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	serve := frozen.FindCommand("serve")
+	if result.Command != serve || serve.Parent != frozen || !serve.Frozen() {
+		t.Fatalf("matched %v, want the snapshot's serve", result.Command)
+	}
+	want := map[string]interface{}{"port": "80", "verbose": true}
+	if !reflect.DeepEqual(result.Options, want) {
+		t.Errorf("options = %v, want %v", result.Options, want)
+	}
+	if serve.FindOption("--port") != serve.Options[2] || serve.HelpOption != serve.Options[0] {
+		t.Error("snapshot options are not indexed")
+	}
+}
+
+// Snapshot nodes share slabs; the lists they hold must still be their own
+func TestFreezeSlabs(t *testing.T) {
+	root := NewCommand("app")
+	root.AddOption(NewOption("--mode <mode>", "Mode").SetKind(KindEnum).SetChoices([]string{"a", "b"}))
+	first := NewCommand("first").SetAliases([]string{"f"})
+	root.AddCommand(first)
+	root.AddCommand(NewCommand("second").SetAliases([]string{"s"}))
+	frozen := root.Freeze()
+
+	root.FindOption("--mode").Choices[0] = "changed"
+	first.Aliases[0] = "changed"
+	if frozen.FindOption("--mode").Choices[0] != "a" || frozen.Commands[0].Aliases[0] != "f" {
+		t.Error("snapshot shares lists with the original")
+	}
+	aliases := append(frozen.Commands[0].Aliases, "extra")
+	if aliases[0] != "f" || frozen.Commands[1].Aliases[0] != "s" {
+		t.Error("appending to a snapshot list wrote into its neighbour")
+	}
+	if len(frozen.Commands[1].Commands) != 0 || frozen.Commands[0].Parent != frozen {
+		t.Error("snapshot tree miswired")
+	}
+}
+
+func TestFrozenCommandsRejectChanges(t *testing.T) {
+	frozen := programTestCommand().Freeze()
+	serve := frozen.FindCommand("serve")
+	for name, change := range map[string]func(){
+		"AddOption":   func() { serve.AddOption(NewOption("--tls", "TLS")) },
+		"AddArgument": func() { serve.AddArgument(NewArgument("[x]", "X")) },
+		"AddCommand":  func() { frozen.AddCommand(NewCommand("extra")) },
+		"Adopt":       func() { NewCommand("other").AddCommand(serve) },
+		"SetAliases":  func() { serve.SetAliases(nil) },
+		"SetVersion":  func() { frozen.SetVersion("2.0.0") },
+	} {
+		func() {
+			defer func() {
+				if recover() == nil {
+					t.Errorf("%s on a frozen command did not panic", name)
+				}
+			}()
+			change()
+		}()
+	}
+}
+
+// Trees from BuildCommandTree are frozen in place; the exports that modify
+// commands must then leave them alone
+func TestMutatingExportsSkipFrozen(t *testing.T) {
+	root := programTestCommand()
+	root.freeze()
+	handle := registerCommand(0, root)
+	defer destroyCommand(handle)
+
+	if _, ok := lookupMutable(handle); ok {
+		t.Error("frozen tree resolved for modification")
+	}
+	if cmd, ok := lookupCommand(handle); !ok || cmd != root {
+		t.Error("frozen tree not resolved for parsing")
+	}
+}
+
+// Run with -race: parses of one snapshot from many goroutines while the
+// tree it was taken from keeps changing
+func TestFrozenParseStress(t *testing.T) {
+	root := programTestCommand()
+	frozen := root.Freeze()
+	inputs := [][]string{
+		{"-c", "x.json", "serve", "--port", "80", "public", "-v"},
+		{"s", "--port=81", "-v", "pub"},
+		{"serve", "status"},
+		{"lax", "--what", "x"},
+		{"serve", "--nope"},
+		{"build", "--help"},
+	}
+
+	stop := make(chan struct{})
+	mutated := make(chan struct{})
+	go func() {
+		defer close(mutated)
+		for i := 0; ; i++ {
+			select {
+			case <-stop:
+				return
+			default:
+			}
+			root.FindCommand("serve").AddOption(NewOption(fmt.Sprintf("--extra-%d", i), "Extra"))
+			root.SetAliases([]string{fmt.Sprint(i)})
+		}
+	}()
+
+	var wg sync.WaitGroup
+	for g := 0; g < 16; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			for i := 0; i < 500; i++ {
+				args := inputs[(g+i)%len(inputs)]
+				outcome := frozen.Run(args)
+				if (outcome.Kind == OutcomeError) != (args[1] == "--nope") {
+					t.Errorf("%v: kind %d", args, outcome.Kind)
+					return
+				}
+				result, err := frozen.ParseArgsPooled(args)
+				if err == nil && result.Request == OutcomeDispatch {
+					result.Values()
+				}
+				result.Release()
+			}
+		}(g)
+	}
+	wg.Wait()
+	close(stop)
+	<-mutated
+}
+
+// Parses of one snapshot by 1 to 64 goroutines; ns/op should fall with
+// the goroutine count up to the number of cores
+func BenchmarkFrozenParseScaling(b *testing.B) {
+	frozen := programTestCommand().Freeze()
+	args := []string{"-c", "x.json", "serve", "--port", "80", "public", "-v"}
+	for _, goroutines := range []int{1, 2, 4, 8, 16, 32, 64} {
+		b.Run(fmt.Sprintf("goroutines=%d", goroutines), func(b *testing.B) {
+			b.ReportAllocs()
+			var wg sync.WaitGroup
+			per := b.N / goroutines
+			b.ResetTimer()
+			for g := 0; g < goroutines; g++ {
+				n := per
+				if g == 0 {
+					n += b.N % goroutines
+				}
+				wg.Add(1)
+				go func(n int) {
+					defer wg.Done()
+					for i := 0; i < n; i++ {
+						result, err := frozen.ParseArgsPooled(args)
+						if err != nil {
+							b.Error(err)
+						}
+						result.Release()
+					}
+				}(n)
+			}
+			wg.Wait()
+		})
+	}
+}
@@ -0,0 +1,3 @@
+module github.com/rohitsoni-dev/gocommander/src/go
+
+go 1.21
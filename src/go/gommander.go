@@ -1,15 +1,21 @@
 package main
 
 /*
+#include <stdint.h>
 #include <stdlib.h>
 */
 import "C"
 
 import (
+	"errors"
 	"fmt"
 	"os"
+	"runtime/debug"
+	"slices"
 	"strconv"
 	"strings"
+	"sync"
+	"sync/atomic"
 	"unsafe"
 )
 
@@ -89,9 +95,13 @@ type Option struct {
 	DefaultValue interface{}
 	Parser       func(string) (interface{}, error)
 	EnvVar       string
+	ConfigKey    string // key of the option in its command's config file, see Command.ConfigFile
 	Hidden       bool
 	IsHelp       bool
 	IsVersion    bool
+	Choices      []string   // allowed values for KindEnum
+	Slot         int        // position among the command's own options, -1 for help/version
+	Kind         OptionKind // type of the option's value, see values.go
 }
 
 // NewOption creates a new option
@@ -128,6 +138,13 @@ func (o *Option) parseFlags() {
 	o.Variadic = strings.Contains(o.Flags, "...")
 }
 
+// SetChoices sets the allowed values of the option and makes it an enum
+func (o *Option) SetChoices(choices []string) *Option {
+	o.Choices = choices
+	o.Kind = KindEnum
+	return o
+}
+
 // SetDefault sets the default value for the option
 func (o *Option) SetDefault(value interface{}) *Option {
 	o.DefaultValue = value
@@ -146,12 +163,37 @@ func (o *Option) SetOptional(optional bool) *Option {
 	return o
 }
 
-// SetEnvVar sets the environment variable for the option
+// SetEnvVar sets the environment variable the option falls back to. Go
+// parses read it from the environment the Go runtime copied when it
+// started, unless the host passes its own with the parse (see ParseInto).
 func (o *Option) SetEnvVar(envVar string) *Option {
 	o.EnvVar = envVar
 	return o
 }
 
+// SetConfigKey sets the config file key the option falls back to. Nested
+// keys are joined with dots; without one the option's name is used.
+func (o *Option) SetConfigKey(key string) *Option {
+	o.ConfigKey = key
+	return o
+}
+
+// configKey returns the key the option is looked up under in config files
+func (o *Option) configKey() string {
+	if o.ConfigKey != "" {
+		return o.ConfigKey
+	}
+	return o.Name()
+}
+
+// flag returns the flag errors name the option by, the long one if any
+func (o *Option) flag() string {
+	if o.LongFlag != "" {
+		return o.LongFlag
+	}
+	return o.ShortFlag
+}
+
 // SetParser sets a custom parser function for the option
 func (o *Option) SetParser(parser func(string) (interface{}, error)) *Option {
 	o.Parser = parser
@@ -188,6 +230,21 @@ type Command struct {
 	AllowUnknown bool
 	HelpOption   *Option
 	Aliases      []string
+	NumSlots     int    // number of options excluding the built-in help/version
+	ActionID     uint32 // host action to dispatch to when matched, 0 for none
+	ConfigFile   string // JSON file of option defaults for this command and its subcommands, see config.go
+
+	AbbreviateCommands bool // match subcommands by unique prefix of a name or alias
+	ResponseFiles      bool // expand "@file" arguments, see responsefile.go; read from the parsed command only
+
+	optionIndex  map[string]*Option // short and long flags to options, see AddOption
+	commandIndex commandTrie        // subcommand names and aliases, see AddCommand
+	program      atomic.Pointer[Program]
+
+	handle   uint64   // handle given to the host, 0 if not registered
+	registry uint32   // registry owning handle
+	frozen   *Program // program of the snapshot c is part of, see freeze.go
+	state    int32    // state of c in frozen
 }
 
 // NewCommand creates a new command
@@ -198,6 +255,8 @@ func NewCommand(name string) *Command {
 		Options:   make([]*Option, 0),
 		Arguments: make([]*Argument, 0),
 		Aliases:   make([]string, 0),
+
+		optionIndex: make(map[string]*Option),
 	}
 
 	// Add default help option
@@ -210,29 +269,134 @@ func NewCommand(name string) *Command {
 
 // AddCommand adds a subcommand
 func (c *Command) AddCommand(cmd *Command) *Command {
+	c.mutable()
+	cmd.mutable()
 	cmd.Parent = c
 	c.Commands = append(c.Commands, cmd)
+	c.indexCommand(len(c.Commands)-1, cmd.Aliases)
+	c.invalidate()
 	return c
 }
 
-// AddOption adds an option
+// indexCommand adds the name and the given aliases of a subcommand to the
+// dispatch index
+func (c *Command) indexCommand(index int, aliases []string) {
+	c.commandIndex.insert(c.Commands[index].Name, index)
+	for _, alias := range aliases {
+		c.commandIndex.insert(alias, index)
+	}
+}
+
+// reindexCommands rebuilds the dispatch index from scratch
+func (c *Command) reindexCommands() {
+	c.commandIndex = commandTrie{}
+	for i, cmd := range c.Commands {
+		c.indexCommand(i, cmd.Aliases)
+	}
+}
+
+// AddOption adds an option. A flag another option already has stays with
+// that option, and the conflict is reported on stderr; AddOptions returns
+// conflicts instead.
 func (c *Command) AddOption(option *Option) *Command {
-	// Check for conflicts
-	for _, opt := range c.Options {
-		if opt.ShortFlag != "" && opt.ShortFlag == option.ShortFlag {
-			fmt.Fprintf(os.Stderr, "Warning: conflicting short flag '%s'\n", option.ShortFlag)
+	c.mutable()
+	for _, diag := range c.addOption(option, nil) {
+		fmt.Fprintf(os.Stderr, "Warning: %s\n", diag)
+	}
+	c.invalidate()
+	return c
+}
+
+// AddOptions adds options in order, as AddOption would one by one, and
+// returns the flag conflicts it found rather than printing them. The flag
+// index and option list are sized once for the whole batch, so building a
+// command with thousands of options stays linear.
+func (c *Command) AddOptions(options []*Option) []Diagnostic {
+	c.mutable()
+	if len(c.optionIndex) < len(options) {
+		index := make(map[string]*Option, len(c.optionIndex)+2*len(options))
+		for flag, opt := range c.optionIndex {
+			index[flag] = opt
 		}
-		if opt.LongFlag != "" && opt.LongFlag == option.LongFlag {
-			fmt.Fprintf(os.Stderr, "Warning: conflicting long flag '%s'\n", option.LongFlag)
+		c.optionIndex = index
+	}
+	c.Options = slices.Grow(c.Options, len(options))
+
+	var diags []Diagnostic
+	for _, option := range options {
+		diags = c.addOption(option, diags)
+	}
+	c.invalidate()
+	return diags
+}
+
+// addOption indexes and appends an option, appending flag conflicts to
+// diags
+func (c *Command) addOption(option *Option, diags []Diagnostic) []Diagnostic {
+	if c.optionIndex == nil {
+		c.optionIndex = make(map[string]*Option)
+	}
+
+	// Index both flags for FindOption. On a conflict the option declared
+	// first keeps the flag, as it did when options were scanned in order.
+	if option.ShortFlag != "" {
+		if holder, exists := c.optionIndex[option.ShortFlag]; exists {
+			diags = append(diags, Diagnostic{Code: DiagConflictingShortFlag, Flag: option.ShortFlag, Option: option, Holder: holder})
+		} else {
+			c.optionIndex[option.ShortFlag] = option
+		}
+	}
+	if option.LongFlag != "" {
+		if holder, exists := c.optionIndex[option.LongFlag]; exists {
+			diags = append(diags, Diagnostic{Code: DiagConflictingLongFlag, Flag: option.LongFlag, Option: option, Holder: holder})
+		} else {
+			c.optionIndex[option.LongFlag] = option
 		}
 	}
 
+	// Built-in options stay out of the slot numbering so slots match the
+	// order in which the caller declared its own options
+	if option.IsHelp || option.IsVersion {
+		option.Slot = -1
+	} else {
+		option.Slot = c.NumSlots
+		c.NumSlots++
+	}
+
 	c.Options = append(c.Options, option)
-	return c
+	return diags
+}
+
+// DiagnosticCode identifies a problem found while building a command
+type DiagnosticCode int
+
+const (
+	DiagConflictingShortFlag DiagnosticCode = iota + 1
+	DiagConflictingLongFlag
+)
+
+// Diagnostic describes a problem found while building a command that did
+// not stop the build
+type Diagnostic struct {
+	Code   DiagnosticCode
+	Flag   string
+	Option *Option // option that did not get Flag
+	Holder *Option // option that kept it
+}
+
+func (d Diagnostic) String() string {
+	switch d.Code {
+	case DiagConflictingShortFlag:
+		return fmt.Sprintf("conflicting short flag '%s'", d.Flag)
+	case DiagConflictingLongFlag:
+		return fmt.Sprintf("conflicting long flag '%s'", d.Flag)
+	}
+	return "invalid command"
 }
 
 // AddArgument adds an argument
 func (c *Command) AddArgument(argument *Argument) *Command {
+	c.mutable()
 	// Check if we already have a variadic argument
 	if len(c.Arguments) > 0 && c.Arguments[len(c.Arguments)-1].Variadic {
 		fmt.Fprintf(os.Stderr, "Error: only the last argument can be variadic\n")
@@ -240,23 +404,37 @@ func (c *Command) AddArgument(argument *Argument) *Command {
 	}
 
 	c.Arguments = append(c.Arguments, argument)
+	c.invalidate()
 	return c
 }
 
 // SetAction sets the action function
 func (c *Command) SetAction(action func([]string, map[string]interface{})) *Command {
+	c.mutable()
 	c.Action = action
 	return c
 }
 
 // SetDescription sets the command description
 func (c *Command) SetDescription(desc string) *Command {
+	c.mutable()
 	c.Description = desc
 	return c
 }
 
+// SetConfigFile sets the JSON file the options of the command and of its
+// subcommands take values from when neither the command line nor their
+// environment variable sets them. A missing file is not an error.
+func (c *Command) SetConfigFile(path string) *Command {
+	c.mutable()
+	c.ConfigFile = path
+	c.invalidate()
+	return c
+}
+
 // SetVersion sets the command version
 func (c *Command) SetVersion(version string) *Command {
+	c.mutable()
 	c.Version = version
 
 	// Add version option if not already present
@@ -269,111 +447,226 @@ func (c *Command) SetVersion(version string) *Command {
 
 // FindCommand finds a subcommand by name
 func (c *Command) FindCommand(name string) *Command {
-	for _, cmd := range c.Commands {
-		if cmd.Name == name {
-			return cmd
-		}
-		// Check aliases
-		for _, alias := range cmd.Aliases {
-			if alias == name {
-				return cmd
-			}
-		}
+	if c.frozen != nil {
+		return c.findCommand(name)
+	}
+	if index := c.findCommandIndex(name); index >= 0 {
+		return c.Commands[index]
 	}
 	return nil
 }
 
-// FindOption finds an option by flag
+// findCommandIndex returns the index of a subcommand by name or alias, or
+// by unique prefix when AbbreviateCommands is set. Exact matches win.
+func (c *Command) findCommandIndex(name string) int {
+	return c.commandIndex.lookup(name, c.AbbreviateCommands)
+}
+
+// FindOption finds an option by flag. Options must have been added with
+// AddOption, which keeps the flag index up to date.
 func (c *Command) FindOption(flag string) *Option {
-	for _, opt := range c.Options {
-		if (opt.ShortFlag != "" && opt.ShortFlag == flag) ||
-			(opt.LongFlag != "" && opt.LongFlag == flag) {
-			return opt
-		}
+	if c.frozen != nil {
+		return c.findOption(flag)
 	}
-	return nil
+	return c.optionIndex[flag]
 }
 
-// ParseCommand parses command line arguments
-func (c *Command) ParseCommand(args []string) error {
-	// Parse options and arguments
-	parsedOptions := make(map[string]interface{})
-	remainingArgs := make([]string, 0)
-
-	i := 0
-	for i < len(args) {
-		arg := args[i]
-
-		// Check for help option
-		if arg == "-h" || arg == "--help" {
-			c.ShowHelp()
-			os.Exit(0)
-		}
-
-		// Check for version option
-		if (arg == "-V" || arg == "--version") && c.Version != "" {
-			fmt.Println(c.Version)
-			os.Exit(0)
-		}
+// ErrorCode identifies why parsing failed
+type ErrorCode int
+
+const (
+	ErrNone ErrorCode = iota
+	ErrUnknownOption
+	ErrMissingOptionArgument
+	ErrMissingArguments
+	ErrInvalidOptionValue
+	ErrInvalidChoice
+	ErrInvalidArgument
+	ErrConfig
+	ErrResponseFile
+)
 
-		// Check if it's an option
-		if strings.HasPrefix(arg, "-") {
-			// Find the option
-			option := c.FindOption(arg)
-			if option == nil {
-				if !c.AllowUnknown {
-					return fmt.Errorf("unknown option '%s'", arg)
-				}
-				remainingArgs = append(remainingArgs, arg)
-				i++
-				continue
-			}
+// IndexEnv is the OptionValue.Index of an option whose value came from its
+// environment variable
+const IndexEnv = -2
+
+// IndexConfig is the OptionValue.Index of an option whose value came from
+// its command's config file
+const IndexConfig = -3
+
+// ParseError describes a parse failure and the argv entry that caused it
+type ParseError struct {
+	Code  ErrorCode
+	Index int // index of the offending token, -1 when not tied to one
+	Token string
+	Value string // rejected value, for the invalid value codes
+	Err   error  // why the value was rejected
+
+	// Closest allowed value to a rejected choice, if any is close
+	Suggestion string
+	// Environment variable or config key a rejected value came from, if
+	// not from argv
+	EnvVar    string
+	ConfigKey string
+
+	owner int // slot of the option, or position of the argument, a value belongs to
+	hint  int // position of Suggestion among the choices plus one, 0 if none
+}
 
-			// Handle option value
-			if option.Required || option.Optional {
-				i++
-				if i >= len(args) {
-					return fmt.Errorf("option '%s' missing argument", arg)
-				}
-				value := args[i]
-				parsedOptions[option.Name()] = value
-			} else {
-				// Boolean flag
-				parsedOptions[option.Name()] = true
-			}
-		} else {
-			// It's a command or argument
-			// Check if it's a subcommand
-			subcmd := c.FindCommand(arg)
-			if subcmd != nil {
-				// Parse subcommand with remaining args
-				return subcmd.ParseCommand(args[i+1:])
-			}
+func (e *ParseError) Unwrap() error {
+	return e.Err
+}
 
-			// It's an argument
-			remainingArgs = append(remainingArgs, arg)
+// suggest fills in the suggestion of a choice error
+func (e *ParseError) suggest(cause error) {
+	var miss *choiceError
+	if errors.As(cause, &miss) {
+		e.Value = miss.value
+		if miss.suggestion >= 0 {
+			e.Suggestion = miss.set.values[miss.suggestion]
+			e.hint = miss.suggestion + 1
 		}
+	}
+}
 
-		i++
+// didYouMean formats the suggestion of a choice error as a message suffix
+func (e *ParseError) didYouMean() string {
+	if e.Suggestion == "" {
+		return ""
 	}
+	return fmt.Sprintf(", did you mean '%s'?", e.Suggestion)
+}
 
-	// Validate arguments
-	if len(remainingArgs) < c.CountRequiredArguments() {
-		return fmt.Errorf("missing required arguments")
+func (e *ParseError) Error() string {
+	if e.EnvVar != "" {
+		return e.message() + fmt.Sprintf(" (from environment variable %s)", e.EnvVar)
 	}
+	if e.ConfigKey != "" {
+		return e.message() + fmt.Sprintf(" (from config key %s)", e.ConfigKey)
+	}
+	return e.message()
+}
 
-	// Apply default values for options
-	for _, opt := range c.Options {
-		if _, exists := parsedOptions[opt.Name()]; !exists && opt.DefaultValue != nil {
-			parsedOptions[opt.Name()] = opt.DefaultValue
+func (e *ParseError) message() string {
+	switch e.Code {
+	case ErrUnknownOption:
+		return fmt.Sprintf("unknown option '%s'", e.Token)
+	case ErrMissingOptionArgument:
+		return fmt.Sprintf("option '%s' missing argument", e.Token)
+	case ErrMissingArguments:
+		return "missing required arguments"
+	case ErrInvalidOptionValue:
+		return fmt.Sprintf("option '%s' argument '%s' is invalid", e.Token, e.Value)
+	case ErrInvalidChoice:
+		return fmt.Sprintf("option '%s' argument '%s' is not an allowed choice", e.Token, e.Value) + e.didYouMean()
+	case ErrInvalidArgument:
+		if errors.Is(e.Err, errNotAChoice) {
+			return fmt.Sprintf("argument '%s' is not an allowed choice", e.Value) + e.didYouMean()
 		}
+		return fmt.Sprintf("argument '%s' is invalid", e.Value)
+	case ErrConfig:
+		return fmt.Sprintf("cannot read config file '%s': %v", e.Token, e.Err)
+	case ErrResponseFile:
+		return fmt.Sprintf("cannot expand response file '%s': %v", e.Token, e.Err)
 	}
+	return "parse error"
+}
 
-	// Execute action if defined
-	if c.Action != nil {
-		c.Action(remainingArgs, parsedOptions)
+// OptionValue records an option set on the command line
+type OptionValue struct {
+	Option *Option
+	Index  int // argv index of the value, -1 for boolean flags, IndexEnv or IndexConfig for values from elsewhere
+	Offset int // byte offset of the value within argv[Index] when given inline ("--name=value", "-j8")
+}
+
+// ParseResult holds the outcome of parsing before any action runs
+type ParseResult struct {
+	Command    *Command
+	Path       []string
+	Route      []int // index of each matched subcommand within its parent
+	Args       []string
+	ArgIndexes []int                  // argv index of each positional argument
+	Options    map[string]interface{} // nil for pooled results, see ParseArgsPooled
+	Set        []OptionValue
+	Slots      SlotValues    // typed values of the matched command's options
+	ArgValues  []interface{} // positionals converted by Argument.Parser, nil if no argument has one
+
+	// OutcomeHelp or OutcomeVersion if the parse stopped at the built-in
+	// flag at argv index RequestIndex, else OutcomeDispatch
+	Request      OutcomeKind
+	RequestIndex int
+
+	program  *Program     // program that produced the result
+	state    int32        // state of Command in program
+	argv     []string     // the arguments that were parsed
+	scratch  []string     // reusable argv views for pooled results
+	tokens   []argToken   // classification of argv, see tokens.go
+	response responseArgs // argv with response files expanded
+
+	// "NAME=value" views of the environment the host passed with the parse,
+	// used instead of the Go runtime's own copy when hostEnv is set, and
+	// their values by name once a lookup needed them
+	environ    []string
+	hostEnv    bool
+	envValues  map[string]string
+	envIndexed bool
+}
+
+// optionMap returns the explicitly set options by name
+func (r *ParseResult) optionMap() map[string]interface{} {
+	options := make(map[string]interface{}, len(r.Set))
+	for _, set := range r.Set {
+		if value, ok := r.value(set.Option); ok {
+			options[set.Option.Name()] = value
+		}
 	}
+	return options
+}
+
+// Values returns the parsed options with default values applied. Options
+// with a Kind hold their typed value; others keep the string (or true for
+// flags) they were given and their DefaultValue as declared.
+func (r *ParseResult) Values() map[string]interface{} {
+	values := r.optionMap()
+	for _, opt := range r.Command.Options {
+		if _, exists := values[opt.Name()]; exists {
+			continue
+		}
+		if value, ok := r.value(opt); ok {
+			values[opt.Name()] = value
+		}
+	}
+	return values
+}
+
+// Argv returns the arguments the indexes of the result refer to: those
+// given to the parse, with response files expanded
+func (r *ParseResult) Argv() []string {
+	return r.argv
+}
 
+// ParseArgs parses command line arguments and returns the matched command
+// together with its positional arguments and explicitly set options. The
+// tree is compiled into a Program on first use (see program.go).
+func (c *Command) ParseArgs(args []string) (*ParseResult, error) {
+	return c.compiled().Parse(args)
+}
+
+// ParseCommand parses command line arguments and runs the matched action.
+// As a CLI would, it prints the help or version and exits when either flag
+// is given; use Run to get them back as an Outcome instead.
+func (c *Command) ParseCommand(args []string) error {
+	outcome := c.Run(args)
+	switch outcome.Kind {
+	case OutcomeHelp:
+		outcome.Command.ShowHelp()
+		os.Exit(0)
+	case OutcomeVersion:
+		fmt.Println(outcome.Text())
+		os.Exit(0)
+	case OutcomeError:
+		return outcome.Err
+	}
 	return nil
 }
 
@@ -490,16 +783,67 @@ func (c *Command) ShowHelp() {
 
 // AllowUnknownOption allows unknown options
 func (c *Command) AllowUnknownOption(allow bool) *Command {
+	c.mutable()
 	c.AllowUnknown = allow
+	c.invalidate()
+	return c
+}
+
+// AllowAbbreviatedCommands lets subcommands be selected by any prefix of
+// their name or an alias that no other subcommand shares
+func (c *Command) AllowAbbreviatedCommands(allow bool) *Command {
+	c.mutable()
+	c.AbbreviateCommands = allow
+	c.invalidate()
+	return c
+}
+
+// AllowResponseFiles makes parses of c replace an argument "@path" by the
+// arguments in the file at path
+func (c *Command) AllowResponseFiles(allow bool) *Command {
+	c.mutable()
+	c.ResponseFiles = allow
+	c.invalidate()
 	return c
 }
 
 // SetAliases sets aliases for the command
 func (c *Command) SetAliases(aliases []string) *Command {
+	c.mutable()
+	old := c.Aliases
 	c.Aliases = aliases
+	c.invalidate()
+	if c.Parent == nil {
+		return c
+	}
+
+	// Keep the parent's dispatch index in step. The trie cannot drop keys,
+	// so it is only rebuilt when an alias went away.
+	index := c.Parent.commandIndex.lookup(c.Name, false)
+	if index < 0 || c.Parent.Commands[index] != c || !containsAll(aliases, old) {
+		c.Parent.reindexCommands()
+		return c
+	}
+	c.Parent.indexCommand(index, aliases)
 	return c
 }
 
+func containsAll(set, items []string) bool {
+	for _, item := range items {
+		found := false
+		for _, s := range set {
+			if s == item {
+				found = true
+				break
+			}
+		}
+		if !found {
+			return false
+		}
+	}
+	return true
+}
+
 // Test function
 func testCommand() {
 	// Create a root command
@@ -532,10 +876,10 @@ func testCommand() {
 	calcCmd.SetDescription("Perform basic calculations")
 	calcCmd.AddArgument(NewArgument("<operation>", "Operation to perform (add, subtract, multiply, divide)"))
 	calcCmd.AddArgument(NewArgument("<numbers...>", "Numbers to operate on"))
-	calcCmd.AddOption(NewOption("-p, --precision <digits>", "Number of decimal places").SetDefault("2"))
+	calcCmd.AddOption(NewOption("-p, --precision <digits>", "Number of decimal places").SetKind(KindInt).SetDefault(2))
 	calcCmd.SetAction(func(args []string, options map[string]interface{}) {
 		operation := args[0]
-		precision, _ := strconv.Atoi(options["precision"].(string))
+		precision := options["precision"].(int64)
 
 		// Convert string numbers to float64
 		numbers := make([]float64, len(args)-1)
@@ -594,33 +938,121 @@ func testCommand() {
 }
 
 // Exported functions for C bindings
-// We use unsafe.Pointer to pass Go objects to C and back
+// Commands are passed to C as opaque uint64 handles (see handles.go)
+
+// Commands handed out to the host live in registries. Every host
+// environment (for Node.js: the main thread and each worker_thread) opens
+// its own registry, so environments never see or reset each other's
+// commands, and everything an environment created is released together
+// when it closes its registry. Registry 0 is the process-wide default used
+// by the legacy exports. Handles are unique across all registries.
+//
+// Resolving a handle goes straight to the lock-free handle table; only
+// registering and releasing commands take registryMu.
+var (
+	commandHandles handleTable
+	registryMu     sync.Mutex
+	registries            = map[uint32]map[uint64]struct{}{0: {}}
+	nextRegistryID uint32 = 1
+)
 
-var commandRegistry = make(map[uintptr]*Command)
-var nextID uintptr = 1
+// openRegistry creates an empty registry and returns its ID
+func openRegistry() uint32 {
+	registryMu.Lock()
+	defer registryMu.Unlock()
+
+	id := nextRegistryID
+	nextRegistryID++
+	registries[id] = make(map[uint64]struct{})
+	return id
+}
+
+// closeRegistry releases every command registered in a registry
+func closeRegistry(registry uint32) {
+	registryMu.Lock()
+	defer registryMu.Unlock()
+
+	for handle := range registries[registry] {
+		commandHandles.release(handle)
+	}
+	if registry == 0 {
+		registries[0] = make(map[uint64]struct{})
+	} else {
+		delete(registries, registry)
+	}
+}
+
+// registerCommand stores a command in a registry and returns its handle,
+// or 0 if the registry is not open
+func registerCommand(registry uint32, cmd *Command) uint64 {
+	registryMu.Lock()
+	defer registryMu.Unlock()
+
+	owned, exists := registries[registry]
+	if !exists {
+		return 0
+	}
+
+	handle := commandHandles.alloc(cmd)
+	if handle != 0 {
+		owned[handle] = struct{}{}
+		cmd.handle = handle
+		cmd.registry = registry
+	}
+	return handle
+}
+
+// destroyCommand releases a command and every registered command in its
+// subtree. Stale handles are ignored so that an explicit destroy and a
+// later finalizer can both run safely.
+func destroyCommand(handle uint64) bool {
+	registryMu.Lock()
+	defer registryMu.Unlock()
+
+	cmd, exists := commandHandles.resolve(handle)
+	if !exists {
+		return false
+	}
+	releaseTree(cmd)
+	return true
+}
+
+func releaseTree(cmd *Command) {
+	if cmd.handle != 0 && commandHandles.release(cmd.handle) {
+		delete(registries[cmd.registry], cmd.handle)
+	}
+	cmd.handle = 0
+	for _, child := range cmd.Commands {
+		releaseTree(child)
+	}
+}
+
+// lookupCommand resolves a command handle
+func lookupCommand(handle uint64) (*Command, bool) {
+	return commandHandles.resolve(handle)
+}
+
+// lookupMutable resolves a command handle for the exports that modify
+// commands, which ignore frozen ones rather than panic in the host
+func lookupMutable(handle uint64) (*Command, bool) {
+	cmd, exists := commandHandles.resolve(handle)
+	return cmd, exists && cmd.frozen == nil
+}
 
 //export CreateCommand
-func CreateCommand(name *C.char) unsafe.Pointer {
+func CreateCommand(name *C.char) C.uint64_t {
 	goName := C.GoString(name)
 	cmd := NewCommand(goName)
 
-	// Store the command in our registry and return its ID
-	id := nextID
-	nextID++
-	commandRegistry[id] = cmd
-
-	// Return the ID as an unsafe.Pointer
-	return unsafe.Pointer(id)
+	// Store the command in the default registry and return its handle
+	return C.uint64_t(registerCommand(0, cmd))
 }
 
 //export AddCommand
-func AddCommand(parentPtr unsafe.Pointer, childPtr unsafe.Pointer) {
-	// Convert pointers back to commands
-	parentID := uintptr(parentPtr)
-	childID := uintptr(childPtr)
-
-	parent, parentExists := commandRegistry[parentID]
-	child, childExists := commandRegistry[childID]
+func AddCommand(parentHandle C.uint64_t, childHandle C.uint64_t) {
+	// Resolve handles back to commands
+	parent, parentExists := lookupMutable(uint64(parentHandle))
+	child, childExists := lookupMutable(uint64(childHandle))
 
 	if parentExists && childExists {
 		parent.AddCommand(child)
@@ -628,10 +1060,9 @@ func AddCommand(parentPtr unsafe.Pointer, childPtr unsafe.Pointer) {
 }
 
 //export Parse
-func Parse(cmdPtr unsafe.Pointer, argc C.int, argv **C.char) C.int {
-	// Convert pointer back to command
-	cmdID := uintptr(cmdPtr)
-	cmd, exists := commandRegistry[cmdID]
+func Parse(cmdHandle C.uint64_t, argc C.int, argv **C.char) C.int {
+	// Resolve the handle back to a command
+	cmd, exists := lookupCommand(uint64(cmdHandle))
 
 	if !exists {
 		return 1 // Error
@@ -645,23 +1076,218 @@ func Parse(cmdPtr unsafe.Pointer, argc C.int, argv **C.char) C.int {
 		args[i] = C.GoString(argPtr)
 	}
 
-	// Parse the command
-	err := cmd.ParseCommand(args)
-	if err != nil {
+	// Parse the command. Help and version requests are returned rather
+	// than printed, since exiting would take the host process down.
+	switch cmd.Run(args).Kind {
+	case OutcomeError:
 		return 1 // Error
+	case OutcomeHelp:
+		return 2
+	case OutcomeVersion:
+		return 3
 	}
 
 	return 0 // Success
 }
 
-// Initialize function for C bindings
+// CreateCommandIn creates an empty command owned by a registry
+//
+//export CreateCommandIn
+func CreateCommandIn(registry C.uint32_t, name *C.char) C.uint64_t {
+	return C.uint64_t(registerCommand(uint32(registry), NewCommand(C.GoString(name))))
+}
+
+// BuildCommandTree rebuilds a whole command tree from a serialized schema
+// (see schema.go) into a registry and returns a handle to its root, or 0
+// if the schema is malformed. The tree is frozen, so the host may parse it
+// from several threads at once.
+//
+//export BuildCommandTree
+func BuildCommandTree(registry C.uint32_t, data *C.char, length C.int) C.uint64_t {
+	schema := unsafe.Slice((*byte)(unsafe.Pointer(data)), int(length))
+	cmd, err := DecodeSchema(schema)
+	if err != nil {
+		return 0
+	}
+	cmd.freeze()
+
+	return C.uint64_t(registerCommand(uint32(registry), cmd))
+}
+
+// DestroyCommand releases a command handle along with the handles of its
+// subcommands. Parses already running on the command are unaffected.
+//
+//export DestroyCommand
+func DestroyCommand(cmdHandle C.uint64_t) {
+	destroyCommand(uint64(cmdHandle))
+}
+
+//export AddOption
+func AddOption(cmdHandle C.uint64_t, flags *C.char, description *C.char, defaultValue *C.char) {
+	cmd, exists := lookupMutable(uint64(cmdHandle))
+	if !exists {
+		return
+	}
+
+	option := NewOption(C.GoString(flags), C.GoString(description))
+	if defaultValue != nil {
+		option.SetDefault(C.GoString(defaultValue))
+	}
+	cmd.AddOption(option)
+}
+
+//export AddArgument
+func AddArgument(cmdHandle C.uint64_t, name *C.char, description *C.char) {
+	cmd, exists := lookupMutable(uint64(cmdHandle))
+	if !exists {
+		return
+	}
+
+	cmd.AddArgument(NewArgument(C.GoString(name), C.GoString(description)))
+}
+
+//export SetDescription
+func SetDescription(cmdHandle C.uint64_t, description *C.char) {
+	if cmd, exists := lookupMutable(uint64(cmdHandle)); exists {
+		cmd.SetDescription(C.GoString(description))
+	}
+}
+
+//export SetVersion
+func SetVersion(cmdHandle C.uint64_t, version *C.char) {
+	if cmd, exists := lookupMutable(uint64(cmdHandle)); exists {
+		cmd.SetVersion(C.GoString(version))
+	}
+}
+
+//export AllowUnknownOption
+func AllowUnknownOption(cmdHandle C.uint64_t, allow C.int) {
+	if cmd, exists := lookupMutable(uint64(cmdHandle)); exists {
+		cmd.AllowUnknownOption(allow != 0)
+	}
+}
+
+// ParseInto parses a packed argv arena (see viewArena) without running Go
+// actions and writes the result into out using the layout described in
+// result.go. outWords is the capacity of out in 32-bit words. envBlob and
+// envOffsets are a second arena of "NAME=value" entries, the host's
+// environment at the time of the parse, which option environment variables
+// are looked up in; with envc < 0 they are looked up in the environment the
+// Go runtime copied when it started. When the matched command has a host
+// action, the dispatch callback is invoked with dispatchCtx and the result.
+// Returns the status recorded in the first word.
+//
+//export ParseInto
+func ParseInto(cmdHandle C.uint64_t, blob *C.char, offsets *C.uint32_t, argc C.int,
+	envBlob *C.char, envOffsets *C.uint32_t, envc C.int,
+	out *C.uint32_t, outWords C.int, dispatchCtx C.uintptr_t) C.int {
+	words := unsafe.Slice((*uint32)(unsafe.Pointer(out)), int(outWords))
+
+	var offs, envOffs []uint32
+	if argc > 0 {
+		offs = unsafe.Slice((*uint32)(unsafe.Pointer(offsets)), int(argc)+1)
+	}
+	if envc >= 0 {
+		envOffs = unsafe.Slice((*uint32)(unsafe.Pointer(envOffsets)), int(envc)+1)
+	}
+	env := hostEnv{blob: unsafe.Pointer(envBlob), offsets: envOffs}
+	return C.int(parseArena(uint64(cmdHandle), unsafe.Pointer(blob), offs, env, words, uintptr(dispatchCtx)))
+}
+
+// hostEnv is the environment arena a host passed with a parse; a nil
+// offsets table means it passed none
+type hostEnv struct {
+	blob    unsafe.Pointer
+	offsets []uint32
+}
+
+var errInvalidHandle = errors.New("invalid command handle")
+
+// parseArena does the work of ParseInto with a pooled result, so a
+// successful parse allocates nothing. The arena is only valid for this
+// call; the encoded result refers to arguments by index and never to the
+// views themselves.
+func parseArena(handle uint64, blob unsafe.Pointer, offsets []uint32, env hostEnv, words []uint32, ctx uintptr) uint32 {
+	cmd, exists := lookupCommand(handle)
+	if !exists {
+		return encodeResult(words, nil, errInvalidHandle)
+	}
+
+	program := cmd.compiled()
+	result := program.acquireResult()
+	defer result.Release()
+
+	result.scratch = appendArena(result.scratch[:0], blob, offsets)
+	if env.offsets != nil {
+		result.environ = appendArena(result.environ[:0], env.blob, env.offsets)
+		result.hostEnv = true
+	}
+	result.response.mapped = true
+	status := parseMapped(program, result, words)
+	if status == uint32(ErrNone) {
+		dispatchAction(ctx, result, words)
+	}
+	return status
+}
+
+// parseMapped parses result.scratch and encodes the result into words
+// with response files mapped rather than read. A file truncated by another
+// process while it is mapped faults on access; the fault is reported as an
+// ErrResponseFile error for the first response file instead of crashing
+// the host.
+func parseMapped(program *Program, result *ParseResult, words []uint32) (status uint32) {
+	defer debug.SetPanicOnFault(debug.SetPanicOnFault(true))
+	defer func() {
+		r := recover()
+		if r == nil {
+			return
+		}
+		index := firstResponseFile(result.scratch)
+		if _, fault := r.(interface{ Addr() uintptr }); !fault || index < 0 {
+			panic(r)
+		}
+		err := &ParseError{Code: ErrResponseFile, Index: index, Token: result.scratch[index][1:], Err: errResponseFileFault}
+		status = encodeResult(words, nil, err)
+	}()
+	err := program.parse(result.scratch, result)
+	return encodeResult(words, result, err)
+}
+
+// SetDispatchCallback registers the host function that runs actions for
+// commands that carry an ActionID (see dispatch.go)
+//
+//export SetDispatchCallback
+func SetDispatchCallback(fn unsafe.Pointer) {
+	setDispatchCallback(fn)
+}
+
+// FreeString releases a string returned by the Go library
+//
+//export FreeString
+func FreeString(str *C.char) {
+	C.free(unsafe.Pointer(str))
+}
+
+// Initialize function for C bindings. It may be called once per host
+// environment, so it must not touch state other environments rely on;
+// per-environment state lives in registries (OpenRegistry).
 //
 //export Initialize
 func Initialize() {
-	// Initialization code if needed
-	// Reset the registry
-	commandRegistry = make(map[uintptr]*Command)
-	nextID = 1
+}
+
+// OpenRegistry creates a registry for one host environment
+//
+//export OpenRegistry
+func OpenRegistry() C.uint32_t {
+	return C.uint32_t(openRegistry())
+}
+
+// CloseRegistry releases every command a host environment created
+//
+//export CloseRegistry
+func CloseRegistry(registry C.uint32_t) {
+	closeRegistry(uint32(registry))
 }
 
 // Version function for C bindings
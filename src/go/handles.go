@@ -0,0 +1,124 @@
+package main
+
+import (
+	"sync"
+	"sync/atomic"
+)
+
+// Handles are how commands are referenced from outside Go. A handle packs
+// a slot index and the generation of the slot when it was allocated:
+//
+//	handle = generation<<32 | index
+//
+// Freeing a slot bumps its generation, so a stale handle never resolves to
+// whatever command reuses the slot later. Generations start at 1, which
+// keeps 0 free to mean "no handle".
+//
+// Slots live in fixed-size pages that are allocated on demand and never
+// move, so resolving a handle is two atomic loads and a generation check
+// with no locks. Allocation and release are serialized by a mutex.
+
+const (
+	handlePageBits = 12
+	handlePageSize = 1 << handlePageBits
+	handleMaxPages = 1 << 12 // 16M live handles
+)
+
+type handleSlot struct {
+	gen atomic.Uint32
+	cmd atomic.Pointer[Command]
+}
+
+type handlePage [handlePageSize]handleSlot
+
+type handleTable struct {
+	pages [handleMaxPages]atomic.Pointer[handlePage]
+
+	mu   sync.Mutex
+	free []uint32 // released slot indexes, reused LIFO
+	next uint32   // first never-used slot index
+}
+
+// alloc stores cmd in a free slot and returns its handle, or 0 if the
+// table is full
+func (t *handleTable) alloc(cmd *Command) uint64 {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+
+	var index uint32
+	if n := len(t.free); n > 0 {
+		index = t.free[n-1]
+		t.free = t.free[:n-1]
+	} else {
+		if t.next >= handlePageSize*handleMaxPages {
+			return 0
+		}
+		index = t.next
+		t.next++
+		if page := index >> handlePageBits; t.pages[page].Load() == nil {
+			fresh := new(handlePage)
+			for i := range fresh {
+				fresh[i].gen.Store(1)
+			}
+			t.pages[page].Store(fresh)
+		}
+	}
+
+	slot := t.slot(index)
+	slot.cmd.Store(cmd)
+	return uint64(slot.gen.Load())<<32 | uint64(index)
+}
+
+// release frees the slot behind a handle; stale handles are ignored
+func (t *handleTable) release(handle uint64) bool {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+
+	index, gen := uint32(handle), uint32(handle>>32)
+	if index >= t.next {
+		return false
+	}
+	slot := t.slot(index)
+	if slot.gen.Load() != gen || slot.cmd.Load() == nil {
+		return false
+	}
+
+	// Invalidate outstanding handles before the slot can be reused
+	next := gen + 1
+	if next == 0 {
+		next = 1
+	}
+	slot.gen.Store(next)
+	slot.cmd.Store(nil)
+	t.free = append(t.free, index)
+	return true
+}
+
+// resolve returns the command behind a handle. It takes no locks and is
+// safe to call concurrently with alloc and release.
+func (t *handleTable) resolve(handle uint64) (*Command, bool) {
+	index, gen := uint32(handle), uint32(handle>>32)
+	if index>>handlePageBits >= handleMaxPages {
+		return nil, false
+	}
+	page := t.pages[index>>handlePageBits].Load()
+	if page == nil {
+		return nil, false
+	}
+
+	// Check the generation on both sides of the load so a concurrent
+	// release and reuse of the slot cannot hand out another command
+	slot := &page[index&(handlePageSize-1)]
+	if slot.gen.Load() != gen {
+		return nil, false
+	}
+	cmd := slot.cmd.Load()
+	if cmd == nil || slot.gen.Load() != gen {
+		return nil, false
+	}
+	return cmd, true
+}
+
+func (t *handleTable) slot(index uint32) *handleSlot {
+	return &t.pages[index>>handlePageBits].Load()[index&(handlePageSize-1)]
+}
@@ -0,0 +1,130 @@
+package main
+
+import (
+	"math/rand"
+	"sync"
+	"testing"
+)
+
+func TestHandleTableGenerations(t *testing.T) {
+	var table handleTable
+	first := NewCommand("first")
+	second := NewCommand("second")
+
+	h1 := table.alloc(first)
+	if cmd, ok := table.resolve(h1); !ok || cmd != first {
+		t.Fatal("fresh handle did not resolve")
+	}
+	if !table.release(h1) || table.release(h1) {
+		t.Fatal("expected exactly one successful release")
+	}
+
+	// The slot is reused, but the old handle must not alias the new command
+	h2 := table.alloc(second)
+	if uint32(h2) != uint32(h1) {
+		t.Fatalf("expected slot reuse, got %x after %x", h2, h1)
+	}
+	if _, ok := table.resolve(h1); ok {
+		t.Fatal("stale handle resolved after slot reuse")
+	}
+	if cmd, ok := table.resolve(h2); !ok || cmd != second {
+		t.Fatal("reused slot did not resolve to the new command")
+	}
+
+	for _, bogus := range []uint64{0, 1 << 32, ^uint64(0), uint64(h2) + 1} {
+		if _, ok := table.resolve(bogus); ok {
+			t.Errorf("bogus handle %x resolved", bogus)
+		}
+	}
+}
+
+func TestHandleTableConcurrentChurn(t *testing.T) {
+	var table handleTable
+	stable := make([]uint64, 64)
+	commands := make([]*Command, len(stable))
+	for i := range stable {
+		commands[i] = NewCommand("stable")
+		stable[i] = table.alloc(commands[i])
+	}
+
+	var wg sync.WaitGroup
+	// Writers keep allocating and releasing slots
+	for w := 0; w < 4; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			cmd := NewCommand("churn")
+			for i := 0; i < 5000; i++ {
+				h := table.alloc(cmd)
+				if got, ok := table.resolve(h); !ok || got != cmd {
+					t.Error("churned handle did not resolve")
+					return
+				}
+				table.release(h)
+				if _, ok := table.resolve(h); ok {
+					t.Error("released handle still resolves")
+					return
+				}
+			}
+		}()
+	}
+	// Readers must always see their own command behind stable handles
+	for r := 0; r < 8; r++ {
+		wg.Add(1)
+		go func(seed int64) {
+			defer wg.Done()
+			rng := rand.New(rand.NewSource(seed))
+			for i := 0; i < 20000; i++ {
+				n := rng.Intn(len(stable))
+				if got, ok := table.resolve(stable[n]); !ok || got != commands[n] {
+					t.Error("stable handle resolved to the wrong command")
+					return
+				}
+			}
+		}(int64(r))
+	}
+	wg.Wait()
+}
+
+// BenchmarkHandleResolveParallel resolves handles from all Ps at once,
+// against the lock-free table and, for comparison, an RWMutex-guarded map
+// like the registry it replaced.
+func BenchmarkHandleResolveParallel(b *testing.B) {
+	const n = 4096
+	var table handleTable
+	handles := make([]uint64, n)
+	legacy := make(map[uintptr]*Command, n)
+	var legacyMu sync.RWMutex
+	for i := range handles {
+		cmd := NewCommand("bench")
+		handles[i] = table.alloc(cmd)
+		legacy[uintptr(i+1)] = cmd
+	}
+
+	b.Run("table", func(b *testing.B) {
+		b.RunParallel(func(pb *testing.PB) {
+			i := 0
+			for pb.Next() {
+				if _, ok := table.resolve(handles[i&(n-1)]); !ok {
+					b.Fatal("miss")
+				}
+				i++
+			}
+		})
+	})
+
+	b.Run("rwmutex-map", func(b *testing.B) {
+		b.RunParallel(func(pb *testing.PB) {
+			i := 0
+			for pb.Next() {
+				legacyMu.RLock()
+				_, ok := legacy[uintptr(i&(n-1)+1)]
+				legacyMu.RUnlock()
+				if !ok {
+					b.Fatal("miss")
+				}
+				i++
+			}
+		})
+	})
+}
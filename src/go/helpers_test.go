@@ -0,0 +1,18 @@
+package main
+
+// newTestCommand returns a command with opts declared in order, and the
+// options by Name, for tests that read values back per option
+func newTestCommand(name string, opts ...*Option) (*Command, map[string]*Option) {
+	cmd := NewCommand(name)
+	return cmd, declareOptions(cmd, opts...)
+}
+
+// declareOptions adds opts to cmd in order and returns them by Name
+func declareOptions(cmd *Command, opts ...*Option) map[string]*Option {
+	byName := make(map[string]*Option, len(opts))
+	for _, opt := range opts {
+		cmd.AddOption(opt)
+		byName[opt.Name()] = opt
+	}
+	return byName
+}
@@ -0,0 +1,159 @@
+package main
+
+import (
+	"hash/maphash"
+	"unsafe"
+)
+
+// The tables a Program parses with hold no Go pointers, so the garbage
+// collector allocates them as single noscan spans and never looks inside
+// them, however large the schema:
+//
+//	text    []byte          every token and string the tables name,
+//	                        interned once
+//	states  []programState  one record per command: spans of the side
+//	                        arrays below and references into text
+//	table   []tableEntry    open-addressed hash of (state, token) to
+//	                        transition, probed linearly
+//
+// The per-slot and per-argument specs are pointer-free records of the
+// same kind: default strings are references into text, list defaults a
+// span of one shared array, and options, choice sets and parsers indexes.
+// Only what has to stay a Go value sits in flat side arrays of the
+// Program: the commands and options results point to, parser functions,
+// compiled choice sets and list defaults. Each is one slice, so the
+// collector scans a few pointers per command rather than maps and
+// slices per command.
+
+// textRef locates a string in Program.text
+type textRef struct {
+	off, len uint32
+}
+
+// span is the range [start, end) of one of the side arrays of a Program
+type span struct {
+	start, end uint32
+}
+
+func (s span) len() int {
+	return int(s.end - s.start)
+}
+
+// tableEntry maps a token of a state to its transition
+type tableEntry struct {
+	key   entryKey
+	hash  uint32 // high bits of the hash of the token
+	token textRef
+	t     transition
+}
+
+// entryKey says what the token of a tableEntry is
+type entryKey uint32
+
+const (
+	entryEmpty  entryKey = iota
+	entryToken           // a whole token
+	entryLetter          // the letter of a "-x" token, for clusters
+)
+
+// str returns a string of the text, sharing its bytes
+func (p *Program) str(ref textRef) string {
+	if ref.len == 0 {
+		return ""
+	}
+	return unsafe.String(&p.text[ref.off], int(ref.len))
+}
+
+// lookup returns the transition of a token or letter in a state. Each
+// state has its own region of the table, so the probes of one lookup stay
+// within a few cache lines.
+func (p *Program) lookup(state *programState, key entryKey, token string) (transition, bool) {
+	region := p.table[state.table.start:state.table.end]
+	h := maphash.String(p.seed, token)
+	mask := uint64(len(region) - 1)
+	for i := h & mask; ; i = (i + 1) & mask {
+		e := &region[i]
+		if e.key == entryEmpty {
+			return transition{}, false
+		}
+		if e.key == key && e.hash == uint32(h>>32) && p.str(e.token) == token {
+			return e.t, true
+		}
+	}
+}
+
+// tableBuilder collects the text and transitions of a Program while it is
+// compiled. Its maps only live for the compile.
+type tableBuilder struct {
+	interned map[string]textRef
+	seen     map[tableKey]struct{}
+	entries  []pendingEntry
+}
+
+type tableKey struct {
+	state int32
+	key   entryKey
+	token string
+}
+
+type pendingEntry struct {
+	state int32
+	tableEntry
+}
+
+// intern returns the reference of s in the text, adding it if needed
+func (p *Program) intern(s string) textRef {
+	if ref, ok := p.build.interned[s]; ok {
+		return ref
+	}
+	ref := textRef{off: uint32(len(p.text)), len: uint32(len(s))}
+	p.text = append(p.text, s...)
+	p.build.interned[s] = ref
+	return ref
+}
+
+// addEntry records a transition of a state and reports whether it was
+// added; the first transition added for a token wins
+func (p *Program) addEntry(state int32, key entryKey, token string, t transition) bool {
+	if _, exists := p.build.seen[tableKey{state, key, token}]; exists {
+		return false
+	}
+	p.build.seen[tableKey{state, key, token}] = struct{}{}
+	p.build.entries = append(p.build.entries, pendingEntry{state: state,
+		tableEntry: tableEntry{key: key, token: p.intern(token), t: t}})
+	return true
+}
+
+// finishTable lays out the transitions of each state in a region of the
+// table at most half full, regions in state order, and drops the builder
+func (p *Program) finishTable() {
+	counts := make([]uint32, len(p.states))
+	for _, e := range p.build.entries {
+		counts[e.state]++
+	}
+	size := uint32(0)
+	for i := range p.states {
+		region := uint32(1)
+		for region < 2*counts[i] {
+			region <<= 1
+		}
+		p.states[i].table = span{start: size, end: size + region}
+		size += region
+	}
+
+	p.seed = maphash.MakeSeed()
+	p.table = make([]tableEntry, size)
+	for _, e := range p.build.entries {
+		state := &p.states[e.state]
+		region := p.table[state.table.start:state.table.end]
+		h := maphash.String(p.seed, p.str(e.token))
+		e.hash = uint32(h >> 32)
+		mask := uint64(len(region) - 1)
+		i := h & mask
+		for region[i].key != entryEmpty {
+			i = (i + 1) & mask
+		}
+		region[i] = e.tableEntry
+	}
+	p.build = nil
+}
@@ -0,0 +1,105 @@
+package main
+
+import (
+	"reflect"
+	"runtime"
+	"testing"
+)
+
+func TestProgramTables(t *testing.T) {
+	p := programTestCommand().Compile()
+	root, serve := &p.states[0], &p.states[2]
+	if p.commands[2].Name != "serve" {
+		t.Fatalf("state 2 is %s", p.commands[2].Name)
+	}
+	for _, tt := range []struct {
+		state *programState
+		key   entryKey
+		token string
+		kind  transitionKind
+		found bool
+	}{
+		{root, entryToken, "--config", transitionValue, true},
+		{root, entryLetter, "c", transitionValue, true},
+		{root, entryToken, "s", transitionEnter, true},
+		{root, entryToken, "--help", transitionHelp, true},
+		{root, entryLetter, "h", transitionHelp, true},
+		{root, entryToken, "--port", 0, false},
+		{root, entryToken, "c", 0, false},
+		{serve, entryToken, "--port", transitionValue, true},
+		{serve, entryLetter, "v", transitionFlag, true},
+		{serve, entryToken, "status", transitionEnter, true},
+		{serve, entryToken, "", 0, false},
+	} {
+		got, found := p.lookup(tt.state, tt.key, tt.token)
+		if found != tt.found || (found && got.kind != tt.kind) {
+			t.Errorf("lookup(%q, %d) = %v %v", tt.token, tt.key, got, found)
+		}
+	}
+
+	// Tokens shared between states are stored once
+	if n := len(p.text); n > 64 {
+		t.Errorf("text holds %d bytes: %q", n, p.text)
+	}
+}
+
+func TestFrozenLookups(t *testing.T) {
+	root := programTestCommand()
+	root.AddOption(NewOption("--help-all", "Long help"))
+	root.AllowAbbreviatedCommands(true)
+	frozen := root.Freeze()
+	serve := frozen.Commands[1]
+
+	if serve.optionIndex != nil || frozen.FindCommand("serve") != serve || frozen.FindCommand("s") != serve {
+		t.Error("frozen subcommands not found through the program")
+	}
+	if frozen.FindCommand("bu") != frozen.Commands[0] || frozen.FindCommand("--config") != nil {
+		t.Error("frozen abbreviations not found")
+	}
+	if serve.FindOption("-p") != serve.Options[2] || serve.FindOption("--help") != serve.HelpOption ||
+		frozen.FindOption("--help-all") != frozen.Options[2] || serve.FindOption("status") != nil {
+		t.Error("frozen options not found through the program")
+	}
+
+	// A frozen subcommand parses from its own state
+	result, err := serve.ParseArgs([]string{"-v", "public", "--port=80"})
+	if err != nil || result.Command != serve || len(result.Path) != 0 ||
+		!reflect.DeepEqual(result.Options, map[string]interface{}{"verbose": true, "port": "80"}) {
+		t.Fatalf("subcommand parse: %v %v", err, result)
+	}
+	if result, err := serve.ParseArgs([]string{"status"}); err != nil || result.Command != serve.Commands[0] ||
+		!reflect.DeepEqual(result.Route, []int{0}) {
+		t.Fatalf("subcommand route: %v %v", err, result.Route)
+	}
+	if serve.Compile() != serve.compiled() {
+		t.Error("Compile of a frozen command rebuilt it")
+	}
+}
+
+// BenchmarkFrozenGC times a full GC cycle with a frozen 50k-command
+// snapshot alive, and reports the stop-the-world pause per cycle, the
+// heap bytes and objects of the snapshot, and what it adds to the cycle
+func BenchmarkFrozenGC(b *testing.B) {
+	root := gcSchema()
+	var before, after runtime.MemStats
+	runtime.GC()
+	runtime.ReadMemStats(&before)
+	treeOnly := timeGC(20)
+	frozen := root.Freeze()
+	runtime.GC()
+	runtime.ReadMemStats(&after)
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		runtime.GC()
+	}
+	b.StopTimer()
+	var end runtime.MemStats
+	runtime.ReadMemStats(&end)
+	b.ReportMetric(float64(end.PauseTotalNs-after.PauseTotalNs)/float64(end.NumGC-after.NumGC), "pause-ns")
+	b.ReportMetric(float64(after.HeapAlloc-before.HeapAlloc), "snapshot-B")
+	b.ReportMetric(float64(after.HeapObjects-before.HeapObjects), "snapshot-objects")
+	b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N)-treeOnly, "snapshot-gc-ns")
+	runtime.KeepAlive(root)
+	runtime.KeepAlive(frozen)
+}
@@ -0,0 +1,42 @@
+//go:build unix
+
+package main
+
+import (
+	"errors"
+	"os"
+	"syscall"
+)
+
+// errFileChanged reports a file whose size changed between stat and mmap
+var errFileChanged = errors.New("file changed while it was mapped")
+
+// mapFile maps the first size bytes of the file at path read-only and
+// private. The data must not be used after unmap is called.
+//
+// Pages not yet touched still follow the file, so one truncated later
+// faults on access rather than reading stale bytes; callers that cannot
+// rule that out run with debug.SetPanicOnFault (see parseArena).
+func mapFile(path string, size int64) (data []byte, unmap func(), err error) {
+	if size == 0 {
+		return nil, func() {}, nil
+	}
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, nil, err
+	}
+	defer f.Close()
+
+	data, err = syscall.Mmap(int(f.Fd()), 0, int(size), syscall.PROT_READ, syscall.MAP_PRIVATE)
+	if err != nil {
+		return nil, nil, err
+	}
+	if info, err := f.Stat(); err != nil || info.Size() != size {
+		syscall.Munmap(data)
+		if err == nil {
+			err = errFileChanged
+		}
+		return nil, nil, err
+	}
+	return data, func() { syscall.Munmap(data) }, nil
+}
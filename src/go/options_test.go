@@ -0,0 +1,106 @@
+package main
+
+import (
+	"fmt"
+	"testing"
+)
+
+func TestFindOption(t *testing.T) {
+	cmd := NewCommand("app")
+	port := NewOption("-p, --port <port>", "Port")
+	cmd.AddOption(port)
+	cmd.AddOption(NewOption("--verbose", "Verbose output"))
+	cmd.AddOption(NewOption("-p, --profile", "Conflicts with --port on -p"))
+
+	if cmd.FindOption("-p") != port || cmd.FindOption("--port") != port {
+		t.Error("flags of the first option do not resolve to it")
+	}
+	if opt := cmd.FindOption("--profile"); opt == nil || opt.LongFlag != "--profile" {
+		t.Error("non-conflicting flag of a later option is not indexed")
+	}
+	if cmd.FindOption("--help") != cmd.HelpOption {
+		t.Error("built-in help option is not indexed")
+	}
+	for _, flag := range []string{"", "-", "--", "-x", "--missing"} {
+		if cmd.FindOption(flag) != nil {
+			t.Errorf("unexpected match for %q", flag)
+		}
+	}
+}
+
+// BenchmarkFindOption looks up the last-declared option, the worst case of
+// a scan in declaration order; the cost should not grow with the count
+func BenchmarkFindOption(b *testing.B) {
+	for _, count := range []int{10, 100, 300, 1000} {
+		cmd := NewCommand("bench")
+		for i := 0; i < count; i++ {
+			cmd.AddOption(NewOption(fmt.Sprintf("--flag-%d <value>", i), ""))
+		}
+		flag := fmt.Sprintf("--flag-%d", count-1)
+
+		b.Run(fmt.Sprintf("options=%d", count), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				if cmd.FindOption(flag) == nil {
+					b.Fatal("miss")
+				}
+			}
+		})
+	}
+}
+
+func TestAddOptions(t *testing.T) {
+	cmd := NewCommand("app")
+	port := NewOption("-p, --port <port>", "Port")
+	profile := NewOption("-p, --profile", "Conflicts with --port on -p")
+	help := NewOption("--help", "Conflicts with the built-in help")
+	verbose := NewOption("-v, --verbose", "Verbose output")
+	diags := cmd.AddOptions([]*Option{port, profile, help, verbose})
+
+	want := []Diagnostic{
+		{Code: DiagConflictingShortFlag, Flag: "-p", Option: profile, Holder: port},
+		{Code: DiagConflictingLongFlag, Flag: "--help", Option: help, Holder: cmd.HelpOption},
+	}
+	if len(diags) != len(want) {
+		t.Fatalf("diagnostics = %v, want %v", diags, want)
+	}
+	for i := range want {
+		if diags[i] != want[i] {
+			t.Errorf("diagnostic %d = %+v, want %+v", i, diags[i], want[i])
+		}
+	}
+	if diags[0].String() != "conflicting short flag '-p'" {
+		t.Errorf("message %q", diags[0].String())
+	}
+
+	if cmd.FindOption("-p") != port || cmd.FindOption("--profile") != profile ||
+		cmd.FindOption("--help") != cmd.HelpOption || cmd.FindOption("-v") != verbose {
+		t.Error("flags resolve to the wrong options")
+	}
+	if len(cmd.Options) != 5 || verbose.Slot != 3 || cmd.NumSlots != 4 {
+		t.Errorf("%d options, verbose in slot %d of %d", len(cmd.Options), verbose.Slot, cmd.NumSlots)
+	}
+	if result, err := cmd.ParseArgs([]string{"-v", "--profile"}); err != nil || len(result.Set) != 2 {
+		t.Errorf("parse after AddOptions: %v", err)
+	}
+}
+
+// BenchmarkAddOptions builds a command with thousands of options; ns per
+// option should stay flat as the count grows
+func BenchmarkAddOptions(b *testing.B) {
+	for _, count := range []int{1000, 10000, 50000} {
+		options := make([]*Option, count)
+		for i := range options {
+			options[i] = NewOption(fmt.Sprintf("--flag-%d <value>", i), "")
+		}
+
+		b.Run(fmt.Sprintf("options=%d", count), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				cmd := NewCommand("bench")
+				if diags := cmd.AddOptions(options); diags != nil {
+					b.Fatal(diags)
+				}
+			}
+			b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*count), "ns/option")
+		})
+	}
+}
@@ -0,0 +1,74 @@
+package main
+
+import "errors"
+
+// OutcomeKind says what a parse asks its caller to do next
+type OutcomeKind uint8
+
+const (
+	OutcomeDispatch OutcomeKind = iota // run the action of the matched command
+	OutcomeHelp                        // show the help of the matched command
+	OutcomeVersion                     // show the version of the matched command
+	OutcomeError                       // report Err
+)
+
+// Outcome is the result of Run. Run never writes to stdout or stderr and
+// never exits, so a host can parse untrusted command lines in-process and
+// decide itself what a help or version request turns into.
+type Outcome struct {
+	Kind    OutcomeKind
+	Command *Command    // command matched, or reached before the error
+	Index   int         // argv index of the help or version flag or of the offending token, -1 if none
+	Err     *ParseError // set for OutcomeError
+}
+
+// Text returns what the outcome would print in a CLI: the help of the
+// command, its version, or the error message. It is empty for dispatch.
+func (o Outcome) Text() string {
+	switch o.Kind {
+	case OutcomeHelp:
+		return NewHelp(o.Command).Generate()
+	case OutcomeVersion:
+		return o.Command.Version
+	case OutcomeError:
+		return o.Err.Error()
+	}
+	return ""
+}
+
+// Run parses args and runs the action of the matched command, like
+// ParseCommand, but reports help and version requests and parse errors in
+// the returned Outcome instead of printing them and exiting. Indexes refer
+// to args with response files expanded. Run is safe to call concurrently
+// on a tree that is not being modified.
+func (c *Command) Run(args []string) Outcome {
+	result, err := c.ParseArgsPooled(args)
+	defer result.Release()
+	if err != nil {
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) {
+			parseErr = &ParseError{Index: -1, Err: err}
+		}
+		return Outcome{Kind: OutcomeError, Command: result.Command, Index: parseErr.Index, Err: parseErr}
+	}
+	if result.Request != OutcomeDispatch {
+		return Outcome{Kind: result.Request, Command: result.Command, Index: result.RequestIndex}
+	}
+
+	// The result goes back to the pool, so the action gets arguments it
+	// may keep
+	if result.Command.Action != nil {
+		actionArgs := append(make([]string, 0, len(result.Args)), result.Args...)
+		result.Command.Action(actionArgs, result.Values())
+	}
+	return Outcome{Kind: OutcomeDispatch, Command: result.Command, Index: -1}
+}
+
+// request ends a parse on the help or version flag at argv index i
+func (r *ParseResult) request(t transition, i int) {
+	r.Request = OutcomeHelp
+	if t.kind == transitionVersion {
+		r.Request = OutcomeVersion
+	}
+	r.RequestIndex = i
+}
@@ -0,0 +1,133 @@
+package main
+
+import (
+	"strings"
+	"sync"
+	"testing"
+)
+
+func outcomeTestCommand(ran *int) *Command {
+	root := NewCommand("app").SetVersion("1.2.3")
+	serve := NewCommand("serve").SetVersion("0.9.0")
+	serve.AddOption(NewOption("-v, --verbose", "Verbose output"))
+	serve.AddOption(NewOption("-p, --port <number>", "Port"))
+	serve.AddArgument(NewArgument("<dir>", "Directory"))
+	serve.SetAction(func([]string, map[string]interface{}) { *ran++ })
+	root.AddCommand(serve)
+	return root
+}
+
+func TestRunOutcomes(t *testing.T) {
+	ran := 0
+	root := outcomeTestCommand(&ran)
+	serve := root.Commands[0]
+	tests := []struct {
+		args    []string
+		kind    OutcomeKind
+		command *Command
+		index   int
+		code    ErrorCode
+	}{
+		{args: []string{"serve", "public"}, kind: OutcomeDispatch, command: serve, index: -1},
+		{args: []string{"--help"}, kind: OutcomeHelp, command: root, index: 0},
+		{args: []string{"serve", "-p", "80", "-h", "--nope"}, kind: OutcomeHelp, command: serve, index: 3},
+		{args: []string{"serve", "-vh"}, kind: OutcomeHelp, command: serve, index: 1},
+		{args: []string{"-V"}, kind: OutcomeVersion, command: root, index: 0},
+		{args: []string{"serve", "--version"}, kind: OutcomeVersion, command: serve, index: 1},
+		{args: []string{"serve", "--nope", "-h"}, kind: OutcomeError, command: serve, index: 1, code: ErrUnknownOption},
+		{args: []string{"serve"}, kind: OutcomeError, command: serve, index: -1, code: ErrMissingArguments},
+	}
+
+	for _, tt := range tests {
+		ran = 0
+		outcome := root.Run(tt.args)
+		if outcome.Kind != tt.kind || outcome.Command != tt.command || outcome.Index != tt.index {
+			t.Errorf("%v: got kind %d command %v index %d", tt.args, outcome.Kind, outcome.Command, outcome.Index)
+			continue
+		}
+		if tt.kind == OutcomeError && (outcome.Err == nil || outcome.Err.Code != tt.code) {
+			t.Errorf("%v: got error %v, want code %d", tt.args, outcome.Err, tt.code)
+		}
+		if want := btoi(tt.kind == OutcomeDispatch); ran != want {
+			t.Errorf("%v: action ran %d times, want %d", tt.args, ran, want)
+		}
+	}
+}
+
+func btoi(b bool) int {
+	if b {
+		return 1
+	}
+	return 0
+}
+
+func TestOutcomeText(t *testing.T) {
+	ran := 0
+	root := outcomeTestCommand(&ran)
+	if text := root.Run([]string{"serve", "-h"}).Text(); !strings.Contains(text, "--port <number>") {
+		t.Errorf("help text %q", text)
+	}
+	if text := root.Run([]string{"-V"}).Text(); text != "1.2.3" {
+		t.Errorf("version text %q", text)
+	}
+	if text := root.Run([]string{"serve", "a", "--nope"}).Text(); text != "unknown option '--nope'" {
+		t.Errorf("error text %q", text)
+	}
+}
+
+func TestEncodeRequests(t *testing.T) {
+	ran := 0
+	root := outcomeTestCommand(&ran)
+	out := make([]uint32, 32)
+
+	result, err := root.ParseArgs([]string{"serve", "-p", "80", "--help"})
+	if status := encodeResult(out, result, err); status != resultStatusHelp {
+		t.Fatalf("help: status %d", status)
+	}
+	want := []uint32{resultStatusHelp, 7, 3, 1, 0, 0, 0}
+	for i, w := range want {
+		if out[i] != w {
+			t.Fatalf("word %d = %d, want %d (%v)", i, out[i], w, out[:len(want)])
+		}
+	}
+
+	result, err = root.ParseArgs([]string{"-V"})
+	if status := encodeResult(out, result, err); status != resultStatusVersion || out[2] != 0 || out[3] != 0 {
+		t.Fatalf("version: status %d index %d path %d", status, out[2], out[3])
+	}
+}
+
+// Untrusted command lines, help requests included, parse concurrently
+// without the process exiting
+func TestRunConcurrent(t *testing.T) {
+	var mu sync.Mutex
+	ran := 0
+	root := NewCommand("app").SetVersion("1.0.0")
+	root.AddArgument(NewArgument("[name]", "Name"))
+	root.SetAction(func([]string, map[string]interface{}) {
+		mu.Lock()
+		ran++
+		mu.Unlock()
+	})
+	root.Compile()
+
+	inputs := [][]string{{"x"}, {"-h"}, {"--version"}, {"--bad"}}
+	var wg sync.WaitGroup
+	for g := 0; g < 8; g++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := 0; i < 1000; i++ {
+				args := inputs[i%len(inputs)]
+				if kind := root.Run(args).Kind; kind != OutcomeKind(i%len(inputs)) {
+					t.Errorf("%v: kind %d", args, kind)
+					return
+				}
+			}
+		}()
+	}
+	wg.Wait()
+	if ran != 8*250 {
+		t.Errorf("action ran %d times", ran)
+	}
+}
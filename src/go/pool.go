@@ -0,0 +1,62 @@
+package main
+
+import "sync"
+
+// Results of ParseArgsPooled and of parses coming through ParseInto are
+// recycled through resultPool. A recycled result keeps the capacity of its
+// slices, and new ones are sized from the program up front, so once the
+// pool is warm a successful parse allocates nothing.
+var resultPool = sync.Pool{
+	New: func() interface{} { return new(ParseResult) },
+}
+
+// acquireResult takes an empty result from the pool, with room for the
+// options and subcommand path of any command in the program
+func (p *Program) acquireResult() *ParseResult {
+	result := resultPool.Get().(*ParseResult)
+	if cap(result.Set) < p.maxOptions {
+		result.Set = make([]OptionValue, 0, p.maxOptions)
+	}
+	if cap(result.Route) < p.maxDepth {
+		result.Path = make([]string, 0, p.maxDepth)
+		result.Route = make([]int, 0, p.maxDepth)
+	}
+	result.Slots.reserve(p.lanes)
+	return result
+}
+
+// ParseArgsPooled is ParseArgs without the per-call allocations: the
+// result comes from a pool and its Options map is left nil; read values
+// through Set, the typed accessors (see values.go), or Values. Call Release once done with the result, after
+// which neither it nor its slices may be used.
+func (c *Command) ParseArgsPooled(args []string) (*ParseResult, error) {
+	program := c.compiled()
+	result := program.acquireResult()
+	return result, program.parse(args, result)
+}
+
+// Release hands a result from ParseArgsPooled back to the pool
+func (r *ParseResult) Release() {
+	r.Command = nil
+	r.Path = r.Path[:0]
+	r.Route = r.Route[:0]
+	r.Args = r.Args[:0]
+	r.ArgIndexes = r.ArgIndexes[:0]
+	r.Options = nil
+	r.Set = r.Set[:0]
+	r.argv = nil
+	r.scratch = r.scratch[:0]
+	r.tokens = r.tokens[:0]
+	r.environ = r.environ[:0]
+	r.hostEnv = false
+	clear(r.envValues)
+	r.envIndexed = false
+	r.response.release()
+	r.program = nil
+	r.ArgValues = nil
+	r.Request = OutcomeDispatch
+	// Lanes keep their size; only drop references into the caller's args
+	clear(r.Slots.strings)
+	clear(r.Slots.custom)
+	resultPool.Put(r)
+}
@@ -0,0 +1,110 @@
+package main
+
+import (
+	"reflect"
+	"testing"
+	"unsafe"
+)
+
+func TestParseArgsPooledMatchesParseArgs(t *testing.T) {
+	root := programTestCommand()
+	for _, args := range [][]string{
+		{"serve", "--port", "80", "public", "-v"},
+		{"-c", "x.json", "build"},
+		{"lax", "--what", "x"},
+	} {
+		want, err := root.ParseArgs(args)
+		if err != nil {
+			t.Fatal(err)
+		}
+		// Run twice so the second parse reuses a released result
+		for round := 0; round < 2; round++ {
+			got, err := root.ParseArgsPooled(args)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if got.Command != want.Command || !sameSlice(got.Route, want.Route) ||
+				!sameSlice(got.Args, want.Args) || !sameSlice(got.Set, want.Set) ||
+				!reflect.DeepEqual(got.Values(), want.Values()) {
+				t.Errorf("%v round %d: pooled result differs", args, round)
+			}
+			got.Release()
+		}
+	}
+}
+
+// sameSlice compares slices, treating nil and empty as equal
+func sameSlice(a, b interface{}) bool {
+	if reflect.ValueOf(a).Len() == 0 && reflect.ValueOf(b).Len() == 0 {
+		return true
+	}
+	return reflect.DeepEqual(a, b)
+}
+
+func TestParseAllocations(t *testing.T) {
+	if raceEnabled {
+		t.Skip("sync.Pool drops items under the race detector")
+	}
+	root := programTestCommand()
+	args := []string{"-c", "x.json", "serve", "--port", "80", "public", "-v"}
+
+	pooled := testing.AllocsPerRun(100, func() {
+		result, err := root.ParseArgsPooled(args)
+		if err != nil {
+			t.Fatal(err)
+		}
+		result.Release()
+	})
+	if pooled != 0 {
+		t.Errorf("ParseArgsPooled: %v allocations per parse", pooled)
+	}
+
+	command := testing.AllocsPerRun(100, func() {
+		if err := root.ParseCommand(args); err != nil {
+			t.Fatal(err)
+		}
+	})
+	if command != 0 {
+		t.Errorf("ParseCommand without an action: %v allocations per parse", command)
+	}
+}
+
+func TestParseArenaAllocations(t *testing.T) {
+	if raceEnabled {
+		t.Skip("sync.Pool drops items under the race detector")
+	}
+	registry := openRegistry()
+	defer closeRegistry(registry)
+	handle := registerCommand(registry, programTestCommand())
+
+	blob := []byte("serve--port80public-v")
+	offsets := []uint32{0, 5, 11, 13, 19, 21}
+	words := make([]uint32, 64)
+
+	allocs := testing.AllocsPerRun(100, func() {
+		status := parseArena(handle, unsafe.Pointer(&blob[0]), offsets, hostEnv{}, words, 0)
+		if status != uint32(ErrNone) {
+			t.Fatalf("status %d", status)
+		}
+	})
+	if allocs != 0 {
+		t.Errorf("parseArena: %v allocations per parse", allocs)
+	}
+	if words[3] != 1 || words[4] != 2 || words[5] != 1 {
+		t.Errorf("unexpected header %v", words[:6])
+	}
+}
+
+func BenchmarkParseArgsPooled(b *testing.B) {
+	root := benchmarkParseCommand()
+	args := benchmarkParseArgs
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		result, err := root.ParseArgsPooled(args)
+		if err != nil {
+			b.Fatal(err)
+		}
+		result.Release()
+	}
+}
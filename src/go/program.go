@@ -0,0 +1,614 @@
+package main
+
+import (
+	"hash/maphash"
+	"os"
+	"strings"
+)
+
+// A Program is a command tree compiled into a flat transition table. Each
+// command becomes a state, and every token a state understands (its option
+// flags, subcommand names and aliases, and the built-in help and version
+// flags) maps to one transition:
+//
+//	(state, token) -> option slot and arity | enter child state | help | version
+//
+// All rows live in one hash table keyed by state and token, so parsing is
+// a single loop doing one lookup per token, after the tokens were
+// classified (see tokens.go). "--name=value" is looked up by its name, and
+// a cluster of short flags such as "-abc" letter by letter under the
+// state's short keys. Tokens missing from the table are unknown options if
+// they are dashed, and positional arguments otherwise. The table and the
+// state records hold no pointers; see layout.go.
+//
+// A Program does not change once compiled, so it can be shared by any
+// number of concurrent parses. It still reads the options and commands it
+// was compiled from, so concurrent parses are only safe on a tree nothing
+// modifies meanwhile, such as a frozen one (see freeze.go).
+type Program struct {
+	states []programState
+	table  []tableEntry
+	text   []byte
+	seed   maphash.Seed
+
+	// Side arrays the states, transitions and slots index into. Only the
+	// first four hold pointers: they are the Go values results hand back
+	// or call, and each is one slice however large the tree is.
+	commands  []*Command                          // by state
+	options   []*Option                           // by transition target; slotSpec.option
+	choices   []*choiceSet                        // slotSpec.choices, argumentSpec.choices
+	parsers   []func(string) (interface{}, error) // slotSpec.parser
+	defaults  []string                            // slotSpec.defList
+	slots     []slotSpec                          // by state span, then Option.Slot
+	arguments []argumentSpec                      // by state span, then position
+	bindings  []envBinding                        // by state span
+
+	// Largest option count, subcommand depth and lane sizes of the tree,
+	// used to size pooled results up front
+	maxOptions int
+	maxDepth   int
+	lanes      [laneKinds]int
+
+	responseFiles bool  // the root command's ResponseFiles
+	start         int32 // state of the root command
+
+	build *tableBuilder // only while compiling
+}
+
+type programState struct {
+	table        span // region of the transition table
+	slots        span
+	arguments    span    // empty unless one of them has a Parser or Choices
+	env          span    // options with an EnvVar
+	config       span    // options by config key, empty without a configFile
+	configFile   textRef // ConfigFile of the command or its nearest ancestor
+	required     int32   // required positional arguments
+	argParsers   bool    // one of the arguments has a Parser
+	allowUnknown bool
+}
+
+// envBinding ties an option to the environment variable or config key it
+// falls back to
+type envBinding struct {
+	name textRef
+	slot int32
+}
+
+// argumentSpec is the compiled form of a positional argument; the
+// argument itself is in the Arguments of the state's command
+type argumentSpec struct {
+	choices  int32 // in Program.choices
+	variadic bool
+}
+
+type transitionKind uint8
+
+const (
+	transitionFlag  transitionKind = iota // boolean option
+	transitionValue                       // option taking the next token
+	transitionEnter                       // subcommand
+	transitionHelp
+	transitionVersion
+)
+
+type transition struct {
+	kind   transitionKind
+	target int32 // option index, or state entered
+	route  int32 // index of the entered subcommand within its parent
+}
+
+// Compile freezes the command tree below c into a Program and caches it
+// for ParseArgs. Changing the tree through Command methods drops the
+// cached program; changes made by assigning fields directly need another
+// Compile. A frozen command keeps the program of its snapshot.
+func (c *Command) Compile() *Program {
+	if c.frozen != nil {
+		return c.compiled()
+	}
+	p := &Program{
+		// Index 0 of these is nil, which zero specs name
+		options:       []*Option{nil},
+		choices:       []*choiceSet{nil},
+		parsers:       []func(string) (interface{}, error){nil},
+		responseFiles: c.ResponseFiles,
+		build: &tableBuilder{
+			interned: make(map[string]textRef),
+			seen:     make(map[tableKey]struct{}),
+		},
+	}
+	p.compileState(c, 0)
+	p.text = append([]byte(nil), p.text...)
+	p.finishTable()
+	c.program.Store(p)
+	return p
+}
+
+// compiled returns the cached program of c, compiling it if needed
+func (c *Command) compiled() *Program {
+	if p := c.program.Load(); p != nil {
+		return p
+	}
+	if c.frozen != nil {
+		p := c.frozenProgram()
+		c.program.Store(p)
+		return p
+	}
+	return c.Compile()
+}
+
+// invalidate drops the cached programs that include c
+func (c *Command) invalidate() {
+	for cmd := c; cmd != nil; cmd = cmd.Parent {
+		cmd.program.Store(nil)
+	}
+}
+
+// compileState adds a state for cmd and, recursively, its subcommands, and
+// returns the state ID. Transitions are added in the order the interpreter
+// used to check them and the first one added for a token wins.
+func (p *Program) compileState(cmd *Command, depth int) int32 {
+	state := int32(len(p.states))
+	if len(cmd.Options) > p.maxOptions {
+		p.maxOptions = len(cmd.Options)
+	}
+	if depth > p.maxDepth {
+		p.maxDepth = depth
+	}
+	p.commands = append(p.commands, cmd)
+	p.states = append(p.states, programState{
+		required:     int32(cmd.CountRequiredArguments()),
+		allowUnknown: cmd.AllowUnknown,
+	})
+
+	p.add(state, "-h", transition{kind: transitionHelp})
+	p.add(state, "--help", transition{kind: transitionHelp})
+	if cmd.Version != "" {
+		p.add(state, "-V", transition{kind: transitionVersion})
+		p.add(state, "--version", transition{kind: transitionVersion})
+	}
+
+	configFile := ""
+	for c := cmd; c != nil && configFile == ""; c = c.Parent {
+		configFile = c.ConfigFile
+	}
+	slots := span{start: uint32(len(p.slots))}
+	p.slots = append(p.slots, make([]slotSpec, cmd.NumSlots)...)
+	slots.end = uint32(len(p.slots))
+	var lanes [laneKinds]int
+	env := span{start: uint32(len(p.bindings))}
+	// The options of cmd are appended to p.options below, in order
+	firstOption := len(p.options)
+	for i, opt := range cmd.Options {
+		if opt.Slot >= 0 && opt.Slot < slots.len() {
+			lane := laneOf(opt.kind())
+			p.slots[int(slots.start)+opt.Slot] = p.newSlotSpec(opt, int32(firstOption+i), int32(lanes[lane]), int32(lanes[laneCustom]))
+			lanes[lane]++
+			if opt.Parser != nil {
+				lanes[laneCustom]++
+			}
+			if opt.EnvVar != "" {
+				p.bindings = append(p.bindings, envBinding{name: p.intern(opt.EnvVar), slot: int32(opt.Slot)})
+			}
+		}
+	}
+	env.end = uint32(len(p.bindings))
+	config := span{start: env.end, end: env.end}
+	if configFile != "" {
+		for _, opt := range cmd.Options {
+			if opt.Slot >= 0 && opt.Slot < slots.len() {
+				p.bindings = append(p.bindings, envBinding{name: p.intern(opt.configKey()), slot: int32(opt.Slot)})
+			}
+		}
+		config.end = uint32(len(p.bindings))
+	}
+	arguments := span{start: uint32(len(p.arguments)), end: uint32(len(p.arguments))}
+	argParsers := false
+	for _, arg := range cmd.Arguments {
+		if arg.Parser != nil || len(arg.Choices) > 0 {
+			for _, arg := range cmd.Arguments {
+				spec := argumentSpec{variadic: arg.Variadic}
+				if choices := newChoiceSet(arg.Choices); choices != nil {
+					spec.choices = int32(len(p.choices))
+					p.choices = append(p.choices, choices)
+				}
+				p.arguments = append(p.arguments, spec)
+				argParsers = argParsers || arg.Parser != nil
+			}
+			arguments.end = uint32(len(p.arguments))
+			break
+		}
+	}
+	for lane, n := range lanes {
+		if n > p.lanes[lane] {
+			p.lanes[lane] = n
+		}
+	}
+	current := &p.states[state]
+	current.slots, current.env, current.config, current.arguments = slots, env, config, arguments
+	current.configFile = p.intern(configFile)
+	current.argParsers = argParsers
+
+	for _, opt := range cmd.Options {
+		t := transition{kind: transitionFlag, target: int32(len(p.options))}
+		if opt.Required || opt.Optional {
+			t.kind = transitionValue
+		}
+		p.options = append(p.options, opt)
+		if opt.ShortFlag != "" {
+			p.add(state, opt.ShortFlag, t)
+		}
+		if opt.LongFlag != "" {
+			p.add(state, opt.LongFlag, t)
+		}
+	}
+
+	children := make([]int32, len(cmd.Commands))
+	for i, child := range cmd.Commands {
+		children[i] = p.compileState(child, depth+1)
+	}
+	enter := func(name string, index int) {
+		// Dashed tokens are always options, so such names never matched
+		if name == "" || name[0] != '-' {
+			p.add(state, name, transition{kind: transitionEnter, target: children[index], route: int32(index)})
+		}
+	}
+	for i, child := range cmd.Commands {
+		enter(child.Name, i)
+		for _, alias := range child.Aliases {
+			enter(alias, i)
+		}
+	}
+	if cmd.AbbreviateCommands {
+		cmd.commandIndex.prefixes(enter)
+	}
+	return state
+}
+
+func (p *Program) add(state int32, token string, t transition) {
+	if p.addEntry(state, entryToken, token, t) && len(token) == 2 && token[0] == '-' && token[1] != '-' {
+		p.addEntry(state, entryLetter, token[1:], t)
+	}
+}
+
+// stateSlots returns the compiled slots of a state by Option.Slot
+func (p *Program) stateSlots(state *programState) []slotSpec {
+	return p.slots[state.slots.start:state.slots.end]
+}
+
+// enter makes state the matched command of result
+func (p *Program) enter(result *ParseResult, state int32) *programState {
+	current := &p.states[state]
+	result.Command = p.commands[state]
+	result.program = p
+	result.state = state
+	result.Slots.reset(current.slots.len())
+	return current
+}
+
+// Parse runs the program over args and returns the matched command with
+// its positional arguments and explicitly set options
+func (p *Program) Parse(args []string) (*ParseResult, error) {
+	result := &ParseResult{Path: make([]string, 0), Args: make([]string, 0)}
+	result.Slots.reserve(p.lanes)
+	if err := p.parse(args, result); err != nil {
+		return result, err
+	}
+	result.Options = result.optionMap()
+	return result, nil
+}
+
+// parse runs the program over args, appending to the slices of an empty
+// result so that a recycled result (see pool.go) is filled without
+// allocating. It leaves result.Options to the caller.
+func (p *Program) parse(args []string, result *ParseResult) error {
+	current := p.enter(result, p.start)
+	if p.responseFiles && hasResponseFile(args) {
+		if err := result.response.expand(args); err != nil {
+			return err
+		}
+		args = result.response.args
+	}
+	result.argv = args
+	result.tokens = tokenize(args, result.tokens)
+
+	for i := 0; i < len(args); i++ {
+		arg, token := args[i], result.tokens[i]
+		if token.kind == tokenTerminator {
+			for i++; i < len(args); i++ {
+				result.Args = append(result.Args, args[i])
+				result.ArgIndexes = append(result.ArgIndexes, i)
+			}
+			break
+		}
+
+		name := arg
+		if token.kind == tokenLongValue {
+			name = arg[:token.split]
+		}
+		t, found := p.lookup(current, entryToken, name)
+		if found && token.kind == tokenLongValue && t.kind != transitionFlag && t.kind != transitionValue {
+			found = false
+		}
+		if !found {
+			if token.kind == tokenCluster {
+				last, ok, err := p.cluster(current, result, args, i)
+				if err != nil {
+					return err
+				}
+				if ok {
+					if result.Request != OutcomeDispatch {
+						return nil
+					}
+					i = last
+					continue
+				}
+			}
+			if token.kind != tokenPositional && !current.allowUnknown {
+				return &ParseError{Code: ErrUnknownOption, Index: i, Token: arg}
+			}
+			result.Args = append(result.Args, arg)
+			result.ArgIndexes = append(result.ArgIndexes, i)
+			continue
+		}
+
+		if token.kind == tokenLongValue {
+			value := arg[token.split+1:]
+			set := OptionValue{Index: i, Offset: int(token.split) + 1}
+			if t.kind == transitionFlag {
+				set = OptionValue{Index: -1}
+			}
+			if err := p.setOption(current, result, t, set, value, true); err != nil {
+				return invalidValue(i, name, value, p.options[t.target].Slot, err)
+			}
+			continue
+		}
+
+		switch t.kind {
+		case transitionFlag:
+			// Only bools and counts need no value; other kinds fail to convert ""
+			if err := p.setOption(current, result, t, OptionValue{Index: -1}, "", false); err != nil {
+				return invalidValue(i, arg, "", p.options[t.target].Slot, err)
+			}
+		case transitionValue:
+			if i+1 >= len(args) {
+				return &ParseError{Code: ErrMissingOptionArgument, Index: i, Token: arg}
+			}
+			i++
+			if err := p.setOption(current, result, t, OptionValue{Index: i}, args[i], true); err != nil {
+				return invalidValue(i-1, arg, args[i], p.options[t.target].Slot, err)
+			}
+		case transitionEnter:
+			// Only what follows the last subcommand belongs to the result
+			current = p.enter(result, t.target)
+			result.Path = append(result.Path, result.Command.Name)
+			result.Route = append(result.Route, int(t.route))
+			result.Args = result.Args[:0]
+			result.ArgIndexes = result.ArgIndexes[:0]
+			result.Set = result.Set[:0]
+		case transitionHelp, transitionVersion:
+			result.request(t, i)
+			return nil
+		}
+	}
+
+	if current.env.len() > 0 {
+		if err := p.applyEnv(current, result); err != nil {
+			return err
+		}
+	}
+	if current.config.len() > 0 {
+		if err := p.applyConfig(current, result); err != nil {
+			return err
+		}
+	}
+	if len(result.Args) < int(current.required) {
+		return &ParseError{Code: ErrMissingArguments, Index: -1}
+	}
+	if current.arguments.len() > 0 {
+		return p.checkArguments(current, result)
+	}
+	return nil
+}
+
+// setOption records an option of state given by transition t. value is
+// ignored for flags when hasValue is false.
+func (p *Program) setOption(state *programState, result *ParseResult, t transition, set OptionValue, value string, hasValue bool) error {
+	set.Option = p.options[t.target]
+	result.Set = append(result.Set, set)
+	if slot := set.Option.Slot; slot >= 0 {
+		return result.Slots.store(slot, p, &p.stateSlots(state)[slot], value, hasValue)
+	}
+	return nil
+}
+
+// cluster applies the short flags of a cluster such as "-abc" at args[i]
+// and returns the index of the last argument it used, which is the next
+// one if the cluster ends with an option taking a value ("-abf file").
+// An option taking a value earlier in the cluster takes the rest of it
+// ("-j8"). ok is false, and nothing is applied, if the cluster holds a
+// letter that is not a short flag of state.
+func (p *Program) cluster(state *programState, result *ParseResult, args []string, i int) (last int, ok bool, err error) {
+	arg := args[i]
+	for j := 1; j < len(arg); j++ {
+		t, found := p.lookup(state, entryLetter, arg[j:j+1])
+		if !found {
+			return i, false, nil
+		}
+		if t.kind == transitionValue {
+			break
+		}
+	}
+
+	for j := 1; j < len(arg); j++ {
+		t, _ := p.lookup(state, entryLetter, arg[j:j+1])
+		switch t.kind {
+		case transitionFlag:
+			if err := p.setOption(state, result, t, OptionValue{Index: -1}, "", false); err != nil {
+				return i, true, invalidValue(i, "-"+arg[j:j+1], "", p.options[t.target].Slot, err)
+			}
+		case transitionValue:
+			if j+1 < len(arg) {
+				value := arg[j+1:]
+				if err := p.setOption(state, result, t, OptionValue{Index: i, Offset: j + 1}, value, true); err != nil {
+					return i, true, invalidValue(i, "-"+arg[j:j+1], value, p.options[t.target].Slot, err)
+				}
+				return i, true, nil
+			}
+			if i+1 >= len(args) {
+				return i, true, &ParseError{Code: ErrMissingOptionArgument, Index: i, Token: arg}
+			}
+			if err := p.setOption(state, result, t, OptionValue{Index: i + 1}, args[i+1], true); err != nil {
+				return i, true, invalidValue(i, "-"+arg[j:j+1], args[i+1], p.options[t.target].Slot, err)
+			}
+			return i + 1, true, nil
+		case transitionHelp, transitionVersion:
+			result.request(t, i)
+			return i, true, nil
+		}
+	}
+	return i, true, nil
+}
+
+// applyEnv gives the options of the matched command that were left off
+// the command line the value of their environment variable, if it is set,
+// so a value comes from the command line, else the environment, else the
+// option's default. Only the variables options name are looked up (see
+// lookupEnv).
+func (p *Program) applyEnv(state *programState, result *ParseResult) error {
+	slots := p.stateSlots(state)
+	for _, binding := range p.bindings[state.env.start:state.env.end] {
+		spec := &slots[binding.slot]
+		opt := p.options[spec.option]
+		if result.Slots.isSet(opt.Slot) {
+			continue
+		}
+		name := p.str(binding.name)
+		value, ok := result.lookupEnv(name)
+		if !ok {
+			continue
+		}
+		if err := result.Slots.store(opt.Slot, p, spec, value, true); err != nil {
+			parseErr := invalidValue(-1, opt.flag(), value, opt.Slot, err)
+			parseErr.EnvVar = name
+			return parseErr
+		}
+		result.Set = append(result.Set, OptionValue{Option: opt, Index: IndexEnv})
+	}
+	return nil
+}
+
+// lookupEnv returns the value of an environment variable for this parse:
+// from the environment the host passed with it, if it did, else from the
+// copy the Go runtime took when it started. Hosts that change their
+// environment later, like Node through process.env, pass theirs so the
+// value Go checks is the one they see. The host's entries are indexed by
+// name on the first lookup of a parse, so the bindings of a command cost
+// one pass over them rather than one each; the map is kept with pooled
+// results and only emptied between parses.
+func (r *ParseResult) lookupEnv(name string) (string, bool) {
+	if !r.hostEnv {
+		return os.LookupEnv(name)
+	}
+	if !r.envIndexed {
+		if r.envValues == nil {
+			r.envValues = make(map[string]string, len(r.environ))
+		}
+		for _, entry := range r.environ {
+			// The first entry of a name wins, as with getenv
+			if i := strings.IndexByte(entry, '='); i > 0 {
+				if _, dup := r.envValues[entry[:i]]; !dup {
+					r.envValues[entry[:i]] = entry[i+1:]
+				}
+			}
+		}
+		r.envIndexed = true
+	}
+	value, ok := r.envValues[name]
+	return value, ok
+}
+
+// applyConfig gives the options of the matched command that neither the
+// command line nor the environment set the value of their key in the
+// command's config file, so defaults come last. List options take every
+// element of an array, other options its last element.
+func (p *Program) applyConfig(state *programState, result *ParseResult) error {
+	configFile := p.str(state.configFile)
+	values, err := loadConfig(configFile)
+	if err != nil {
+		return &ParseError{Code: ErrConfig, Index: -1, Token: configFile, Err: err}
+	}
+	if values == nil {
+		return nil
+	}
+	slots := p.stateSlots(state)
+	for _, binding := range p.bindings[state.config.start:state.config.end] {
+		spec := &slots[binding.slot]
+		opt := p.options[spec.option]
+		items, ok := values[p.str(binding.name)]
+		if !ok || len(items) == 0 || result.Slots.isSet(opt.Slot) {
+			continue
+		}
+		if laneOf(spec.kind) != laneList {
+			items = items[len(items)-1:]
+		}
+		for _, value := range items {
+			if err := result.Slots.store(opt.Slot, p, spec, value, true); err != nil {
+				parseErr := invalidValue(-1, opt.flag(), value, opt.Slot, err)
+				parseErr.ConfigKey = p.str(binding.name)
+				return parseErr
+			}
+		}
+		result.Set = append(result.Set, OptionValue{Option: opt, Index: IndexConfig})
+	}
+	return nil
+}
+
+// checkArguments checks each positional argument against the Choices of
+// its declared argument and runs its Parser, the last declared argument
+// taking all the rest if it is variadic. ArgValues is only filled if an
+// argument has a Parser; positionals without one keep their string.
+func (p *Program) checkArguments(state *programState, result *ParseResult) error {
+	arguments := p.arguments[state.arguments.start:state.arguments.end]
+	if state.argParsers {
+		result.ArgValues = make([]interface{}, len(result.Args))
+	}
+	for i, value := range result.Args {
+		position := i
+		if position >= len(arguments) {
+			position = len(arguments) - 1
+			if !arguments[position].variadic {
+				position = -1
+			}
+		}
+		if position < 0 {
+			if state.argParsers {
+				result.ArgValues[i] = value
+			}
+			continue
+		}
+
+		arg := result.Command.Arguments[position]
+		if choices := p.choices[arguments[position].choices]; choices != nil && choices.find(value) < 0 {
+			return invalidArgument(result.ArgIndexes[i], arg, value, position, choices.miss(value))
+		}
+		if !state.argParsers {
+			continue
+		}
+		if arg.Parser == nil {
+			result.ArgValues[i] = value
+			continue
+		}
+		parsed, err := arg.Parser(value)
+		if err != nil {
+			return invalidArgument(result.ArgIndexes[i], arg, value, position, err)
+		}
+		result.ArgValues[i] = parsed
+	}
+	return nil
+}
+
+func invalidArgument(index int, arg *Argument, value string, position int, cause error) error {
+	err := &ParseError{Code: ErrInvalidArgument, Index: index, Token: arg.Name, Value: value, Err: cause, owner: position}
+	err.suggest(cause)
+	return err
+}
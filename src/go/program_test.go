@@ -0,0 +1,201 @@
+package main
+
+import (
+	"fmt"
+	"reflect"
+	"runtime"
+	"testing"
+	"time"
+)
+
+func programTestCommand() *Command {
+	root := NewCommand("app")
+	root.AddOption(NewOption("-c, --config <file>", "Config file"))
+	root.AddCommand(NewCommand("build"))
+	serve := NewCommand("serve").SetAliases([]string{"s"})
+	serve.AddOption(NewOption("-v, --verbose", "Verbose output"))
+	serve.AddOption(NewOption("-p, --port <number>", "Port"))
+	serve.AddArgument(NewArgument("<dir>", "Directory"))
+	serve.AddCommand(NewCommand("status"))
+	root.AddCommand(serve)
+	lax := NewCommand("lax").AllowUnknownOption(true)
+	root.AddCommand(lax)
+	return root
+}
+
+func TestProgramParse(t *testing.T) {
+	root := programTestCommand()
+	tests := []struct {
+		args    []string
+		path    []string
+		route   []int
+		argIdx  []int
+		options map[string]interface{}
+		code    ErrorCode
+		errIdx  int
+	}{
+		{args: []string{"-c", "x.json", "build"}, path: []string{"build"}, route: []int{0},
+			options: map[string]interface{}{}},
+		{args: []string{"s", "--port", "-1", "public", "-v"}, path: []string{"serve"}, route: []int{1},
+			argIdx: []int{3}, options: map[string]interface{}{"port": "-1", "verbose": true}},
+		{args: []string{"stray", "serve", "status"}, path: []string{"serve", "status"}, route: []int{1, 0},
+			options: map[string]interface{}{}},
+		{args: []string{"lax", "--what", "x"}, path: []string{"lax"}, route: []int{2},
+			argIdx: []int{1, 2}, options: map[string]interface{}{}},
+		{args: []string{"serve", "public", "--nope"}, code: ErrUnknownOption, errIdx: 2},
+		{args: []string{"serve", "public", "--port"}, code: ErrMissingOptionArgument, errIdx: 2},
+		{args: []string{"serve"}, code: ErrMissingArguments, errIdx: -1},
+	}
+
+	for _, tt := range tests {
+		result, err := root.ParseArgs(tt.args)
+		if tt.code != ErrNone {
+			parseErr, ok := err.(*ParseError)
+			if !ok || parseErr.Code != tt.code || parseErr.Index != tt.errIdx {
+				t.Errorf("%v: got error %v, want code %d at %d", tt.args, err, tt.code, tt.errIdx)
+			}
+			continue
+		}
+		if err != nil {
+			t.Errorf("%v: %v", tt.args, err)
+			continue
+		}
+		if !reflect.DeepEqual(result.Path, tt.path) || !reflect.DeepEqual(result.Route, tt.route) ||
+			len(result.ArgIndexes) != len(tt.argIdx) || !reflect.DeepEqual(result.Options, tt.options) {
+			t.Errorf("%v: got path %v route %v args %v options %v", tt.args,
+				result.Path, result.Route, result.ArgIndexes, result.Options)
+		}
+		for i, index := range tt.argIdx {
+			if result.ArgIndexes[i] != index || result.Args[i] != tt.args[index] {
+				t.Errorf("%v: positional %d = %d", tt.args, i, result.ArgIndexes[i])
+			}
+		}
+	}
+}
+
+func TestProgramRecompilesAfterChanges(t *testing.T) {
+	root := programTestCommand()
+	serve := root.FindCommand("serve")
+	before := root.Compile()
+
+	if _, err := root.ParseArgs([]string{"serve", "--host", "h", "dir"}); err == nil {
+		t.Fatal("--host accepted before it was added")
+	}
+	serve.AddOption(NewOption("--host <host>", "Host"))
+	if root.compiled() == before {
+		t.Fatal("changing a subcommand kept the compiled program")
+	}
+	result, err := root.ParseArgs([]string{"serve", "--host", "h", "dir"})
+	if err != nil || result.Options["host"] != "h" {
+		t.Fatalf("--host not parsed after recompiling: %v %v", err, result.Options)
+	}
+
+	root.AllowAbbreviatedCommands(true)
+	if result, err := root.ParseArgs([]string{"bu"}); err != nil || result.Command.Name != "build" {
+		t.Fatalf("abbreviation not compiled: %v", err)
+	}
+}
+
+// benchmarkParseCommand has many options and subcommands, and
+// benchmarkParseArgs is a typical command line for it
+func benchmarkParseCommand() *Command {
+	root := NewCommand("app")
+	for i := 0; i < 50; i++ {
+		root.AddCommand(NewCommand(fmt.Sprintf("cmd-%d", i)))
+	}
+	deploy := NewCommand("deploy")
+	for i := 0; i < 300; i++ {
+		deploy.AddOption(NewOption(fmt.Sprintf("--flag-%d <value>", i), ""))
+	}
+	deploy.AddOption(NewOption("-f, --force", "Force"))
+	deploy.AddArgument(NewArgument("<service>", "Service"))
+	root.AddCommand(deploy)
+	return root
+}
+
+var benchmarkParseArgs = []string{"deploy", "--flag-10", "a", "--flag-200", "b", "-f", "api", "--flag-299", "c"}
+
+func BenchmarkParseArgs(b *testing.B) {
+	root := benchmarkParseCommand()
+	args := benchmarkParseArgs
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := root.ParseArgs(args); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+// gcSchema is a code-generated cloud CLI of about 50k commands: 50
+// services of 1000 operations, each with a few options and an argument
+func gcSchema() *Command {
+	root := NewCommand("cloud").SetVersion("1.0.0")
+	root.AddOption(NewOption("-p, --profile <name>", "Profile"))
+	for s := 0; s < 50; s++ {
+		service := NewCommand(fmt.Sprintf("service-%d", s))
+		for o := 0; o < 1000; o++ {
+			op := NewCommand(fmt.Sprintf("operation-%d", o)).SetAliases([]string{fmt.Sprintf("op%d", o)})
+			op.AddOptions([]*Option{
+				NewOption("-r, --region <region>", "Region"),
+				NewOption("--dry-run", "Dry run"),
+				NewOption(fmt.Sprintf("--resource-%d-id <id>", o), "Resource").SetKind(KindInt),
+			})
+			op.AddArgument(NewArgument("[name]", "Name"))
+			service.AddCommand(op)
+		}
+		root.AddCommand(service)
+	}
+	return root
+}
+
+// BenchmarkProgramGC times a full GC cycle with the compiled program of a
+// 50k-command schema alive, and reports the stop-the-world pause per
+// cycle, the heap bytes and objects the program itself takes, and what it
+// adds to the cycle
+func BenchmarkProgramGC(b *testing.B) {
+	root := gcSchema()
+	var before, after runtime.MemStats
+	runtime.GC()
+	runtime.ReadMemStats(&before)
+	treeOnly := timeGC(20)
+	program := root.Compile()
+	runtime.GC()
+	runtime.ReadMemStats(&after)
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		runtime.GC()
+	}
+	b.StopTimer()
+	var end runtime.MemStats
+	runtime.ReadMemStats(&end)
+	b.ReportMetric(float64(end.PauseTotalNs-after.PauseTotalNs)/float64(end.NumGC-after.NumGC), "pause-ns")
+	b.ReportMetric(float64(after.HeapAlloc-before.HeapAlloc), "program-B")
+	b.ReportMetric(float64(after.HeapObjects-before.HeapObjects), "program-objects")
+	b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N)-treeOnly, "program-gc-ns")
+	runtime.KeepAlive(program)
+}
+
+// timeGC returns the mean duration of n forced GC cycles in nanoseconds
+func timeGC(n int) float64 {
+	start := time.Now()
+	for i := 0; i < n; i++ {
+		runtime.GC()
+	}
+	return float64(time.Since(start).Nanoseconds()) / float64(n)
+}
+
+func BenchmarkParseLargeSchema(b *testing.B) {
+	root := gcSchema().Freeze()
+	args := []string{"-p", "dev", "service-42", "op917", "--region", "eu", "--resource-917-id", "7", "db"}
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		result, err := root.ParseArgsPooled(args)
+		if err != nil {
+			b.Fatal(err)
+		}
+		result.Release()
+	}
+}
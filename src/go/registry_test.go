@@ -0,0 +1,99 @@
+package main
+
+import (
+	"sync"
+	"testing"
+)
+
+func TestRegistriesAreIsolated(t *testing.T) {
+	first := openRegistry()
+	second := openRegistry()
+
+	a := registerCommand(first, NewCommand("a"))
+	b := registerCommand(second, NewCommand("b"))
+	if a == 0 || b == 0 || a == b {
+		t.Fatalf("unexpected IDs %d and %d", a, b)
+	}
+
+	// Closing one environment's registry leaves the other untouched
+	closeRegistry(first)
+	if _, exists := lookupCommand(a); exists {
+		t.Error("command survived closing its registry")
+	}
+	if cmd, exists := lookupCommand(b); !exists || cmd.Name != "b" {
+		t.Error("command of another registry was released")
+	}
+
+	if id := registerCommand(first, NewCommand("late")); id != 0 {
+		t.Errorf("registered into a closed registry: %d", id)
+	}
+	closeRegistry(second)
+}
+
+func TestRegistryConcurrentAccess(t *testing.T) {
+	var wg sync.WaitGroup
+	for w := 0; w < 8; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			registry := openRegistry()
+			for i := 0; i < 200; i++ {
+				id := registerCommand(registry, NewCommand("cmd"))
+				if _, exists := lookupCommand(id); !exists {
+					t.Errorf("command %d not found", id)
+					return
+				}
+			}
+			closeRegistry(registry)
+		}()
+	}
+	wg.Wait()
+}
+
+func TestDestroyCommandReleasesSubtree(t *testing.T) {
+	registry := openRegistry()
+	defer closeRegistry(registry)
+
+	root := NewCommand("root")
+	child := NewCommand("child")
+	rootHandle := registerCommand(registry, root)
+	childHandle := registerCommand(registry, child)
+	root.AddCommand(child)
+
+	if !destroyCommand(rootHandle) {
+		t.Fatal("destroy of a live handle failed")
+	}
+	for _, handle := range []uint64{rootHandle, childHandle} {
+		if _, exists := lookupCommand(handle); exists {
+			t.Errorf("handle %x survived destroy", handle)
+		}
+	}
+	if n := len(registries[registry]); n != 0 {
+		t.Errorf("registry still owns %d handles", n)
+	}
+
+	// A finalizer running after an explicit destroy must be harmless
+	if destroyCommand(rootHandle) || destroyCommand(childHandle) {
+		t.Error("stale handle destroyed twice")
+	}
+}
+
+func TestDestroyCommandReusesSlots(t *testing.T) {
+	registry := openRegistry()
+	defer closeRegistry(registry)
+
+	commandHandles.mu.Lock()
+	before := commandHandles.next
+	commandHandles.mu.Unlock()
+
+	for i := 0; i < 100000; i++ {
+		destroyCommand(registerCommand(registry, NewCommand("cycle")))
+	}
+
+	commandHandles.mu.Lock()
+	grown := commandHandles.next - before
+	commandHandles.mu.Unlock()
+	if grown > 1 {
+		t.Errorf("create/destroy cycles grew the handle table by %d slots", grown)
+	}
+}
@@ -0,0 +1,253 @@
+package main
+
+import (
+	"errors"
+	"os"
+	"slices"
+	"unsafe"
+)
+
+// Response files carry command lines longer than the operating system
+// lets a process be started with. When a command allows them (see
+// AllowResponseFiles), an argument "@path" is replaced by the arguments
+// read from path, which may name further response files.
+//
+// Files are split like a shell splits words: whitespace separates
+// arguments, single quotes keep everything up to the closing quote, double
+// quotes keep everything but let a backslash escape '"' and '\', and
+// outside quotes a backslash escapes the next byte, or joins lines before
+// a newline. A '#' starting an argument comments out the rest of the line.
+// Relative paths, including those of nested files, are relative to the
+// working directory.
+//
+// Arguments are views of the file's bytes rather than copies unless
+// quoting or escapes changed them. ParseInto maps files into memory and
+// unmaps them once the result is encoded; other parses read them onto the
+// heap, since their results outlive the call. A mapped file truncated by
+// another process mid-parse faults on access; ParseInto turns the fault
+// into an ErrResponseFile error (see parseArena).
+
+const (
+	responseFileMaxDepth = 8         // nesting of response files
+	responseFileMaxBytes = 256 << 20 // combined size of the files of one parse
+)
+
+var (
+	errResponseFileDepth = errors.New("response files nested too deeply")
+	errResponseFileSize  = errors.New("response files too large")
+	errResponseFileQuote = errors.New("unterminated quote")
+	errResponseFileFault = errors.New("file changed while it was read")
+)
+
+// responseArgs is the argument list of a parse after response files were
+// expanded. Kept in the result so pooled results reuse its slices.
+type responseArgs struct {
+	args   []string // the expanded arguments
+	origin []uint32 // per argument, its argv index, or argc plus its position among arguments from files
+	argc   int      // arguments before expansion
+	files  int      // arguments read from files
+	bytes  int64    // combined size of the files read
+	refs   []uint32 // expanded indexes of the arguments from files a result refers to
+	unmaps []func()
+	mapped bool // map files rather than read them
+}
+
+func isResponseFile(arg string) bool {
+	return len(arg) > 1 && arg[0] == '@'
+}
+
+// hasResponseFile reports whether any argument names a response file
+func hasResponseFile(args []string) bool {
+	return firstResponseFile(args) >= 0
+}
+
+// firstResponseFile returns the index of the first argument naming a
+// response file, or -1
+func firstResponseFile(args []string) int {
+	for i, arg := range args {
+		if isResponseFile(arg) {
+			return i
+		}
+	}
+	return -1
+}
+
+// expand replaces the response files among args by their arguments
+func (r *responseArgs) expand(args []string) error {
+	r.argc = len(args)
+	for i, arg := range args {
+		if !isResponseFile(arg) {
+			r.args = append(r.args, arg)
+			r.origin = append(r.origin, uint32(i))
+			continue
+		}
+		if err := r.include(arg[1:], 1); err != nil {
+			// The error refers to args as given
+			r.origin = r.origin[:0]
+			return &ParseError{Code: ErrResponseFile, Index: i, Token: arg[1:], Err: err}
+		}
+	}
+	return nil
+}
+
+func (r *responseArgs) include(path string, depth int) error {
+	if depth > responseFileMaxDepth {
+		return errResponseFileDepth
+	}
+	info, err := os.Stat(path)
+	if err != nil {
+		return err
+	}
+	if r.bytes += info.Size(); r.bytes > responseFileMaxBytes {
+		return errResponseFileSize
+	}
+
+	var data []byte
+	if r.mapped {
+		var unmap func()
+		if data, unmap, err = mapFile(path, info.Size()); err != nil {
+			return err
+		}
+		r.unmaps = append(r.unmaps, unmap)
+	} else if data, err = os.ReadFile(path); err != nil {
+		return err
+	}
+
+	t := responseTokenizer{data: data}
+	for {
+		arg, ok, err := t.next()
+		if err != nil || !ok {
+			return err
+		}
+		if isResponseFile(arg) {
+			if err := r.include(arg[1:], depth+1); err != nil {
+				return err
+			}
+			continue
+		}
+		r.args = append(r.args, arg)
+		r.origin = append(r.origin, uint32(r.argc+r.files))
+		r.files++
+	}
+}
+
+// index returns the index the host knows the expanded argument i by
+func (r *responseArgs) index(i int) uint32 {
+	if len(r.origin) == 0 {
+		return uint32(i)
+	}
+	return r.origin[i]
+}
+
+// refer records that the result refers to expanded argument i, if it was
+// read from a file
+func (r *responseArgs) refer(i int) {
+	if i >= 0 && i < len(r.origin) && int(r.origin[i]) >= r.argc {
+		r.refs = append(r.refs, uint32(i))
+	}
+}
+
+// sortRefs puts the referred arguments in file order, without repeats
+func (r *responseArgs) sortRefs() {
+	slices.Sort(r.refs)
+	r.refs = slices.Compact(r.refs)
+}
+
+// release unmaps the files and empties the lists for reuse
+func (r *responseArgs) release() {
+	for _, unmap := range r.unmaps {
+		unmap()
+	}
+	clear(r.args)
+	clear(r.unmaps)
+	*r = responseArgs{args: r.args[:0], origin: r.origin[:0], refs: r.refs[:0], unmaps: r.unmaps[:0]}
+}
+
+// responseTokenizer splits the contents of a response file into arguments
+type responseTokenizer struct {
+	data []byte
+	pos  int
+}
+
+func isResponseSpace(c byte) bool {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'
+}
+
+// view returns b as a string sharing its bytes
+func view(b []byte) string {
+	if len(b) == 0 {
+		return ""
+	}
+	return unsafe.String(&b[0], len(b))
+}
+
+// next returns the next argument, or false at the end of the data
+func (t *responseTokenizer) next() (string, bool, error) {
+	data := t.data
+	for t.pos < len(data) {
+		if c := data[t.pos]; c == '#' {
+			for t.pos < len(data) && data[t.pos] != '\n' {
+				t.pos++
+			}
+		} else if isResponseSpace(c) {
+			t.pos++
+		} else {
+			break
+		}
+	}
+	if t.pos == len(data) {
+		return "", false, nil
+	}
+
+	// Most arguments are plain words or one quoted span, both views
+	start := t.pos
+	for t.pos < len(data) && !isResponseSpace(data[t.pos]) &&
+		data[t.pos] != '\'' && data[t.pos] != '"' && data[t.pos] != '\\' {
+		t.pos++
+	}
+	if t.pos == len(data) || isResponseSpace(data[t.pos]) {
+		return view(data[start:t.pos]), true, nil
+	}
+	if quote := data[start]; t.pos == start && quote != '\\' {
+		end := start + 1
+		for end < len(data) && data[end] != quote && (quote == '\'' || data[end] != '\\') {
+			end++
+		}
+		if end < len(data) && data[end] == quote && (end+1 == len(data) || isResponseSpace(data[end+1])) {
+			t.pos = end + 1
+			return view(data[start+1 : end]), true, nil
+		}
+	}
+
+	// Otherwise the argument is rebuilt without its quotes and escapes
+	arg := append([]byte(nil), data[start:t.pos]...)
+	var quote byte
+	for ; t.pos < len(data); t.pos++ {
+		c := data[t.pos]
+		switch {
+		case quote == 0 && isResponseSpace(c):
+			return string(arg), true, nil
+		case quote == 0 && (c == '\'' || c == '"'):
+			quote = c
+		case quote != 0 && c == quote:
+			quote = 0
+		case c == '\\' && quote != '\'' && t.pos+1 < len(data):
+			next := data[t.pos+1]
+			switch {
+			case quote == '"' && next != '"' && next != '\\':
+				arg = append(arg, c)
+			case quote == 0 && next == '\n':
+				t.pos++
+			default:
+				arg = append(arg, next)
+				t.pos++
+			}
+		default:
+			arg = append(arg, c)
+		}
+	}
+	if quote != 0 {
+		return "", false, errResponseFileQuote
+	}
+	return string(arg), true, nil
+}
@@ -0,0 +1,222 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"reflect"
+	"strings"
+	"testing"
+	"unsafe"
+)
+
+func TestResponseTokenizer(t *testing.T) {
+	tests := []struct {
+		in   string
+		want []string
+	}{
+		{"", nil},
+		{"  a\tb\r\nc  ", []string{"a", "b", "c"}},
+		{`'a b' "c d" ''`, []string{"a b", "c d", ""}},
+		{`x'y z'"w"`, []string{"xy zw"}},
+		{`a\ b c\\d`, []string{"a b", `c\d`}},
+		{`"q\"uote" "back\\slash" "keep\n"`, []string{`q"uote`, `back\slash`, `keep\n`}},
+		{`'single \ "raw"'`, []string{`single \ "raw"`}},
+		{"line\\\ncontinued", []string{"linecontinued"}},
+		{"# comment\n--flag # trailing\nvalue#kept\n# at end", []string{"--flag", "value#kept"}},
+		{"héllo 'wörld'", []string{"héllo", "wörld"}},
+	}
+	for _, tt := range tests {
+		tok := responseTokenizer{data: []byte(tt.in)}
+		var got []string
+		for {
+			arg, ok, err := tok.next()
+			if err != nil {
+				t.Fatalf("%q: %v", tt.in, err)
+			}
+			if !ok {
+				break
+			}
+			got = append(got, arg)
+		}
+		if !reflect.DeepEqual(got, tt.want) {
+			t.Errorf("%q: got %q, want %q", tt.in, got, tt.want)
+		}
+	}
+
+	for _, in := range []string{`"open`, `a'b`} {
+		tok := responseTokenizer{data: []byte(in)}
+		if _, _, err := tok.next(); err != errResponseFileQuote {
+			t.Errorf("%q: got %v", in, err)
+		}
+	}
+}
+
+func TestResponseTokenizerViews(t *testing.T) {
+	data := []byte(`plain 'quoted span' "dq span" mi"x"ed`)
+	tok := responseTokenizer{data: data}
+	inData := func(s string) bool {
+		p := uintptr(unsafe.Pointer(unsafe.StringData(s)))
+		start := uintptr(unsafe.Pointer(&data[0]))
+		return p >= start && p < start+uintptr(len(data))
+	}
+	for _, wantView := range []bool{true, true, true, false} {
+		arg, _, _ := tok.next()
+		if inData(arg) != wantView {
+			t.Errorf("%q: view = %v", arg, !wantView)
+		}
+	}
+}
+
+// writeResponseFile writes a response file into dir and returns its path
+func writeResponseFile(t testing.TB, dir, name, content string) string {
+	path := filepath.Join(dir, name)
+	if err := os.WriteFile(path, []byte(content), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	return path
+}
+
+func responseTestCommand() (*Command, map[string]*Option) {
+	root, o := newTestCommand("build",
+		NewOption("-j, --jobs <n>", "Jobs").SetKind(KindInt),
+		NewOption("-D, --define <macro>", "Macro").SetKind(KindStringList),
+	)
+	root.AllowResponseFiles(true)
+	root.AddArgument(NewArgument("[files...]", "Files"))
+	return root, o
+}
+
+func TestResponseFileExpansion(t *testing.T) {
+	dir := t.TempDir()
+	inner := writeResponseFile(t, dir, "inner.rsp", "-D 'NAME=two words' c.c\n")
+	outer := writeResponseFile(t, dir, "outer.rsp", "--jobs 8 -D A=1\nb.c @"+inner+"\n")
+	root, o := responseTestCommand()
+	jobs, define := o["jobs"], o["define"]
+
+	result, err := root.ParseArgs([]string{"a.c", "@" + outer, "d.c"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.Int(jobs) != 8 || !reflect.DeepEqual(result.Strings(define), []string{"A=1", "NAME=two words"}) {
+		t.Errorf("jobs %d define %q", result.Int(jobs), result.Strings(define))
+	}
+	if !reflect.DeepEqual(result.Args, []string{"a.c", "b.c", "c.c", "d.c"}) {
+		t.Errorf("args %q", result.Args)
+	}
+	if argv := result.Argv(); len(argv) != 10 || argv[result.ArgIndexes[3]] != "d.c" {
+		t.Errorf("argv %q, indexes %v", argv, result.ArgIndexes)
+	}
+
+	// Commands that do not allow response files keep the argument
+	root.AllowResponseFiles(false)
+	if result, err := root.ParseArgs([]string{"@" + outer}); err != nil || result.Args[0] != "@"+outer {
+		t.Errorf("disabled: %v %v", result.Args, err)
+	}
+}
+
+func TestResponseFileErrors(t *testing.T) {
+	dir := t.TempDir()
+	root, _ := responseTestCommand()
+	loop := writeResponseFile(t, dir, "loop.rsp", "@"+filepath.Join(dir, "loop.rsp"))
+	quote := writeResponseFile(t, dir, "quote.rsp", `-D "unterminated`)
+	tests := []struct {
+		path  string
+		cause error
+	}{
+		{loop, errResponseFileDepth},
+		{quote, errResponseFileQuote},
+		{filepath.Join(dir, "missing.rsp"), fs.ErrNotExist},
+	}
+	for _, tt := range tests {
+		_, err := root.ParseArgs([]string{"x.c", "@" + tt.path})
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) || parseErr.Code != ErrResponseFile || parseErr.Index != 1 ||
+			parseErr.Token != tt.path || !errors.Is(err, tt.cause) {
+			t.Errorf("%s: got %v", tt.path, err)
+		}
+	}
+}
+
+// TestEncodeResponseFileArgs pins the words the response file check in
+// test/advanced-test.js decodes
+func TestEncodeResponseFileArgs(t *testing.T) {
+	dir := t.TempDir()
+	path := writeResponseFile(t, dir, "args.rsp", "-j 4 'b c.c'")
+	root, _ := responseTestCommand()
+	program := root.compiled()
+
+	// Mapped as ParseInto does; the words must not refer to the mapping
+	result := program.acquireResult()
+	result.response.mapped = true
+	err := program.parse([]string{"a.c", "@" + path}, result)
+	out := make([]uint32, 64)
+	status := encodeResult(out, result, err)
+	result.Release()
+	if status != uint32(ErrNone) {
+		t.Fatalf("status %d (%v)", status, err)
+	}
+	want := []uint32{
+		0, 22, resultNone, 0, 1, 2,
+		0, 3,
+		0, 4,
+		4, 0,
+		// "4" and "b c.c" but not "-j", which no word refers to, then
+		// their indexes, offsets and lengths, then count
+		0, 0, 0,
+		3, 12, 1, 4, 13, 5, 2,
+	}
+	copy(want[12:], textBytes("4"))
+	copy(want[13:15], textBytes("b c.c"))
+	if !reflect.DeepEqual(out[:len(want)], want) {
+		t.Errorf("words = %v\nwant    %v", out[:len(want)], want)
+	}
+
+	// Arguments after a response file keep their argv index
+	result, err = root.ParseArgs([]string{"a.c", "@" + path, "-j"})
+	if status := encodeResult(out, result, err); status != uint32(ErrMissingOptionArgument) || out[2] != 2 {
+		t.Errorf("status %d, errorIndex %d", status, out[2])
+	}
+}
+
+// A file that changes between stat and mmap is not parsed
+func TestMapFileChanged(t *testing.T) {
+	path := writeResponseFile(t, t.TempDir(), "short.rsp", "-j 4")
+	if _, _, err := mapFile(path, 8); err == nil {
+		t.Error("mapped a file shorter than its stat size")
+	}
+}
+
+// textBytes returns s as NUL-padded native-endian words
+func textBytes(s string) []uint32 {
+	words := make([]uint32, textWords(s, nil))
+	writeText(words, s, nil)
+	return words
+}
+
+func BenchmarkResponseFile(b *testing.B) {
+	var content strings.Builder
+	for i := 0; i < 100000; i++ {
+		fmt.Fprintf(&content, "src/module%d/file%d.c -D 'FLAG_%d=a b'\n", i%100, i, i)
+	}
+	path := writeResponseFile(b, b.TempDir(), "big.rsp", content.String())
+	root, _ := responseTestCommand()
+	program := root.compiled()
+	args := []string{"@" + path}
+
+	for _, mapped := range []bool{false, true} {
+		b.Run(fmt.Sprintf("mapped=%v", mapped), func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				result := program.acquireResult()
+				result.response.mapped = mapped
+				if err := program.parse(args, result); err != nil || len(result.Args) != 100000 {
+					b.Fatal(err)
+				}
+				result.Release()
+			}
+		})
+	}
+}
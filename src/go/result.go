@@ -0,0 +1,372 @@
+package main
+
+import (
+	"errors"
+	"math"
+	"unsafe"
+)
+
+// Parse results cross the FFI boundary as a flat array of native-endian
+// uint32 words written into a buffer owned by the caller, so no host
+// objects are built per option. Values are not copied out: they are argv
+// indices, and defaults are left to the caller, which already knows them.
+//
+//	word 0  status       ErrorCode, or a resultStatus* code
+//	word 1  size         words written; words required on resultStatusTooSmall
+//	word 2  errorIndex   argv index of the offending token, or resultNone
+//	word 3  pathLen      number of matched subcommands
+//	word 4  optionCount  number of options set on the command line
+//	word 5  argCount     number of positional arguments
+//	then    path         pathLen words: child index at each level
+//	then    options      optionCount pairs: slot, argv index of the value
+//	                     (resultNone for boolean flags, resultEnv for
+//	                     values from the option's environment variable,
+//	                     resultConfig for values from the config file)
+//	then    args         argCount words: argv index of each positional
+//	then    values       optionCount pairs: the option's converted value as
+//	                     two words, low word first: an
+//	                     int64 for bool, int, count, duration (ns), byte
+//	                     size and enum (choice index) kinds, float64 bits
+//	                     for floats; for string kinds, the byte offset of
+//	                     the value within its argument (non-zero for
+//	                     "--name=value" and "-j8"), or for those set from
+//	                     the environment or the config file the word
+//	                     offset and byte length of their text
+//	then    text         UTF-8 text of environment and config values, each
+//	                     padded to a whole word; list items are separated
+//	                     by NUL
+//	then    file args    only if the words refer to arguments read from
+//	                     response files: the text of each, padded like
+//	                     config text, then a triple per argument (index,
+//	                     word offset, byte length) in index order, then
+//	                     their count as the last word
+//
+// Indexes refer to the arguments as the host passed them. An argument read
+// from a response file is instead numbered argc plus its position among
+// the arguments from files. Only the arguments the other words refer to
+// are copied, so a response file with a million arguments costs the words
+// of those that became values.
+//
+// Values are those after the whole command line was read, so an option
+// given twice carries its final value (a count, say) in both entries.
+//
+// A parse stopped by the help or version flag writes resultStatusHelp or
+// resultStatusVersion, the flag's index as errorIndex, and the path of the
+// command whose help or version was asked for, followed by file arguments.
+// Actions are not dispatched for either.
+//
+// A parse error writes the header and the path of the command reached.
+// For ErrInvalidOptionValue, ErrInvalidChoice, and ErrInvalidArgument
+// caused by a choice, word 4 holds the slot of the option or the position
+// of the argument the value was meant for, and word 5 the position of the
+// suggested choice plus one, or 0 if there is none. A rejected option
+// value from the option's environment variable has resultEnv as its
+// errorIndex, one from the config file resultConfig, and the value's text,
+// NUL-padded, follows the path. So does the text of the cause of
+// ErrConfig (a JSON syntax error, say). File arguments follow both.
+
+const (
+	resultHeaderWords = 6
+	resultNone        = ^uint32(0)
+	resultEnv         = resultNone - 1
+	resultConfig      = resultNone - 2
+)
+
+// Statuses that are not parse errors
+const (
+	resultStatusInvalidHandle = 100
+	resultStatusTooSmall      = 101
+	resultStatusHelp          = 102
+	resultStatusVersion       = 103
+)
+
+// resultWords returns how many words encodeResult needs for a result
+func resultWords(result *ParseResult) int {
+	words := resultHeaderWords + len(result.Route) + 4*len(result.Set) + len(result.ArgIndexes)
+	for _, set := range result.Set {
+		if one, list, ok := sourceText(result, set); ok {
+			words += textWords(one, list)
+		}
+	}
+	referValues(result)
+	return words + fileArgWords(result)
+}
+
+// referValues collects the arguments from response files that the values
+// and positionals of a result refer to
+func referValues(result *ParseResult) {
+	r := &result.response
+	r.refs = r.refs[:0]
+	if r.files == 0 {
+		return
+	}
+	for _, set := range result.Set {
+		r.refer(set.Index)
+	}
+	for _, index := range result.ArgIndexes {
+		r.refer(index)
+	}
+	r.sortRefs()
+}
+
+// encodeResult writes the outcome of a parse into out and returns the
+// status it recorded
+func encodeResult(out []uint32, result *ParseResult, err error) uint32 {
+	if len(out) < resultHeaderWords {
+		return resultStatusTooSmall
+	}
+
+	if err != nil {
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) {
+			return writeStatus(out, resultStatusInvalidHandle)
+		}
+		status := writeStatus(out, uint32(parseErr.Code))
+		if parseErr.Index >= 0 {
+			out[2] = uint32(parseErr.Index)
+			if result != nil {
+				out[2] = result.response.index(parseErr.Index)
+			}
+		}
+		if result != nil && writeRoute(out, result) {
+			// The host reads the offending token and the one after it,
+			// which may hold the rejected value
+			r := &result.response
+			r.refs = r.refs[:0]
+			r.refer(parseErr.Index)
+			r.refer(parseErr.Index + 1)
+			if parseErr.ConfigKey != "" || parseErr.EnvVar != "" {
+				out[2] = resultConfig
+				if parseErr.EnvVar != "" {
+					out[2] = resultEnv
+				}
+				appendText(out, parseErr.Value)
+			} else if parseErr.Code == ErrConfig && parseErr.Err != nil {
+				appendText(out, parseErr.Err.Error())
+			}
+			appendFileArgs(out, result)
+		}
+		if parseErr.Code == ErrInvalidOptionValue || parseErr.Code == ErrInvalidChoice ||
+			errors.Is(parseErr.Err, errNotAChoice) {
+			out[4] = uint32(parseErr.owner)
+			out[5] = uint32(parseErr.hint)
+		}
+		return status
+	}
+
+	if result.Request != OutcomeDispatch {
+		status := writeStatus(out, resultStatusHelp)
+		if result.Request == OutcomeVersion {
+			status = writeStatus(out, resultStatusVersion)
+		}
+		out[2] = result.response.index(result.RequestIndex)
+		result.response.refs = result.response.refs[:0]
+		result.response.refer(result.RequestIndex)
+		if writeRoute(out, result) {
+			appendFileArgs(out, result)
+		}
+		return status
+	}
+
+	size := resultWords(result)
+	if size > len(out) {
+		writeStatus(out, resultStatusTooSmall)
+		out[1] = uint32(size)
+		return resultStatusTooSmall
+	}
+
+	out[0] = uint32(ErrNone)
+	out[1] = uint32(size)
+	out[2] = resultNone
+	out[3] = uint32(len(result.Route))
+	out[4] = uint32(len(result.Set))
+	out[5] = uint32(len(result.ArgIndexes))
+
+	pos := resultHeaderWords
+	for _, index := range result.Route {
+		out[pos] = uint32(index)
+		pos++
+	}
+	for _, set := range result.Set {
+		out[pos] = uint32(set.Option.Slot)
+		out[pos+1] = resultNone
+		if set.Index >= 0 {
+			out[pos+1] = result.response.index(set.Index)
+		} else if set.Index == IndexEnv {
+			out[pos+1] = resultEnv
+		} else if set.Index == IndexConfig {
+			out[pos+1] = resultConfig
+		}
+		pos += 2
+	}
+	for _, index := range result.ArgIndexes {
+		out[pos] = result.response.index(index)
+		pos++
+	}
+	text := pos + 2*len(result.Set)
+	for _, set := range result.Set {
+		if one, list, ok := sourceText(result, set); ok {
+			words := textWords(one, list)
+			writeText(out[text:text+words], one, list)
+			out[pos] = uint32(text)
+			out[pos+1] = uint32(textLen(one, list))
+			text += words
+		} else {
+			bits := slotBits(result, set)
+			out[pos] = uint32(bits)
+			out[pos+1] = uint32(bits >> 32)
+		}
+		pos += 2
+	}
+	if words := fileArgWords(result); words > 0 {
+		writeFileArgs(out[text:text+words], text, result)
+	}
+
+	return uint32(ErrNone)
+}
+
+// writeRoute adds the path of the command a parse reached to a header-only
+// result, and reports false if out cannot hold it
+func writeRoute(out []uint32, result *ParseResult) bool {
+	pos := resultHeaderWords + len(result.Route)
+	if pos > len(out) {
+		return false
+	}
+	out[1] = uint32(pos)
+	out[3] = uint32(len(result.Route))
+	for i, index := range result.Route {
+		out[resultHeaderWords+i] = uint32(index)
+	}
+	return true
+}
+
+// appendText adds NUL-padded text after the words already written, if it
+// fits
+func appendText(out []uint32, text string) {
+	if pos, words := int(out[1]), textWords(text, nil); pos+words <= len(out) {
+		writeText(out[pos:pos+words], text, nil)
+		out[1] = uint32(pos + words)
+	}
+}
+
+// appendFileArgs adds the referred arguments read from response files
+// after the words already written, if they fit
+func appendFileArgs(out []uint32, result *ParseResult) {
+	if pos, words := int(out[1]), fileArgWords(result); words > 0 && pos+words <= len(out) {
+		writeFileArgs(out[pos:pos+words], pos, result)
+		out[1] = uint32(pos + words)
+	}
+}
+
+// fileArgWords returns the words taken by the referred arguments read
+// from response files, 0 if there are none
+func fileArgWords(result *ParseResult) int {
+	r := &result.response
+	if len(r.refs) == 0 {
+		return 0
+	}
+	words := 3*len(r.refs) + 1
+	for _, i := range r.refs {
+		words += textWords(r.args[i], nil)
+	}
+	return words
+}
+
+// writeFileArgs writes the referred arguments read from response files
+// into out, which starts at word start of the result
+func writeFileArgs(out []uint32, start int, result *ParseResult) {
+	r := &result.response
+	table := len(out) - 3*len(r.refs) - 1
+	text := 0
+	for _, i := range r.refs {
+		arg := r.args[i]
+		words := textWords(arg, nil)
+		writeText(out[text:text+words], arg, nil)
+		out[table] = r.origin[i]
+		out[table+1] = uint32(start + text)
+		out[table+2] = uint32(len(arg))
+		text += words
+		table += 3
+	}
+	out[len(out)-1] = uint32(len(r.refs))
+}
+
+// sourceText returns the text of a string or list option set from the
+// environment or the config file, which unlike other string values is not
+// in argv for the host to read
+func sourceText(result *ParseResult, set OptionValue) (one string, list []string, ok bool) {
+	if set.Index != IndexConfig && set.Index != IndexEnv {
+		return "", nil, false
+	}
+	spec := result.spec(set.Option)
+	if spec == nil {
+		return "", nil, false
+	}
+	switch laneOf(spec.kind) {
+	case laneString:
+		return result.String(set.Option), nil, true
+	case laneList:
+		return "", result.Strings(set.Option), true
+	}
+	return "", nil, false
+}
+
+// textLen returns the byte length of one followed by the items of list
+// separated by NUL
+func textLen(one string, list []string) int {
+	n := len(one)
+	for i, item := range list {
+		if i > 0 {
+			n++
+		}
+		n += len(item)
+	}
+	return n
+}
+
+func textWords(one string, list []string) int {
+	return (textLen(one, list) + 3) / 4
+}
+
+// writeText copies the text of one and list into out, which has exactly
+// textWords words, zeroing the padding
+func writeText(out []uint32, one string, list []string) {
+	if len(out) == 0 {
+		return
+	}
+	b := unsafe.Slice((*byte)(unsafe.Pointer(&out[0])), 4*len(out))
+	n := copy(b, one)
+	for i, item := range list {
+		if i > 0 {
+			b[n] = 0
+			n++
+		}
+		n += copy(b[n:], item)
+	}
+	clear(b[n:])
+}
+
+// slotBits returns the converted value of an option as 64 bits, or for
+// string kinds where its value starts in the argument
+func slotBits(result *ParseResult, set OptionValue) uint64 {
+	spec := result.spec(set.Option)
+	if spec == nil {
+		return 0
+	}
+	switch laneOf(spec.kind) {
+	case laneInt:
+		return uint64(result.Int(set.Option))
+	case laneFloat:
+		return math.Float64bits(result.Float(set.Option))
+	}
+	return uint64(set.Offset)
+}
+
+// writeStatus records a header-only result
+func writeStatus(out []uint32, status uint32) uint32 {
+	out[0] = status
+	out[1] = resultHeaderWords
+	out[2] = resultNone
+	out[3], out[4], out[5] = 0, 0, 0
+	return status
+}
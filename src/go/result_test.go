@@ -0,0 +1,64 @@
+package main
+
+import "testing"
+
+func resultTestCommand() *Command {
+	root := NewCommand("app")
+	serve := NewCommand("serve")
+	serve.AddOption(NewOption("-v, --verbose", "Verbose output"))
+	serve.AddOption(NewOption("-p, --port <number>", "Port"))
+	serve.AddArgument(NewArgument("<dir>", "Directory"))
+	root.AddCommand(NewCommand("build"))
+	root.AddCommand(serve)
+	return root
+}
+
+func TestEncodeResult(t *testing.T) {
+	root := resultTestCommand()
+	args := []string{"serve", "--port", "9000", "public", "-v"}
+	result, err := root.ParseArgs(args)
+
+	out := make([]uint32, 32)
+	if status := encodeResult(out, result, err); status != uint32(ErrNone) {
+		t.Fatalf("status = %d", status)
+	}
+
+	want := []uint32{
+		0, 16, resultNone, 1, 2, 1, // header
+		1,                   // path: serve is the second child
+		1, 2, 0, resultNone, // --port <argv 2>, --verbose
+		3,          // positional "public"
+		0, 0, 1, 0, // values: --port is a string, --verbose true
+	}
+	for i, w := range want {
+		if out[i] != w {
+			t.Fatalf("word %d = %d, want %d (%v)", i, out[i], w, out[:len(want)])
+		}
+	}
+}
+
+func TestEncodeResultErrors(t *testing.T) {
+	root := resultTestCommand()
+	out := make([]uint32, 32)
+
+	result, err := root.ParseArgs([]string{"serve", "public", "--nope"})
+	if status := encodeResult(out, result, err); status != uint32(ErrUnknownOption) || out[2] != 2 {
+		t.Fatalf("unknown option: status %d index %d", status, out[2])
+	}
+
+	result, err = root.ParseArgs([]string{"serve", "public", "--port"})
+	if status := encodeResult(out, result, err); status != uint32(ErrMissingOptionArgument) || out[2] != 2 {
+		t.Fatalf("missing value: status %d index %d", status, out[2])
+	}
+
+	result, err = root.ParseArgs([]string{"serve"})
+	if status := encodeResult(out, result, err); status != uint32(ErrMissingArguments) || out[2] != resultNone {
+		t.Fatalf("missing arguments: status %d index %d", status, out[2])
+	}
+
+	result, err = root.ParseArgs([]string{"serve", "a", "-v"})
+	small := make([]uint32, resultHeaderWords+1)
+	if status := encodeResult(small, result, err); status != resultStatusTooSmall || small[1] != 12 {
+		t.Fatalf("too small: status %d size %d", status, small[1])
+	}
+}
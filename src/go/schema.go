@@ -0,0 +1,274 @@
+package main
+
+import (
+	"encoding/binary"
+	"errors"
+	"math"
+)
+
+// Serialized command trees let a host language define a whole CLI with a
+// single call instead of one call per command, option and argument.
+//
+// All integers are little-endian. A string is a uint32 byte length followed
+// by UTF-8 bytes. The buffer starts with schemaMagic and holds one node:
+//
+//	node     := name description version flags:u8 actionID:u32 configFile
+//	            optionCount:u32 option* argumentCount:u32 argument*
+//	            childCount:u32 node*
+//	option   := flags description defaultKind:u8 [default]
+//	            kind:u8 choiceCount:u32 choice* envVar configKey
+//	argument := name description choiceCount:u32 choice*
+//
+// Defaults are encoded according to their kind: a string, a float64 for
+// numbers, or a single byte for booleans. An option's kind is its
+// OptionKind, with choice strings for KindEnum. An actionID of 0 means the
+// node has no host action; an empty configFile or configKey, none.
+
+const schemaMagic = "GMS1"
+
+// Node flags
+const (
+	schemaAllowUnknown = 1 << 0
+	schemaAbbreviate   = 1 << 1
+	schemaResponseFile = 1 << 2
+)
+
+// Default value kinds
+const (
+	schemaDefaultNone   = 0
+	schemaDefaultString = 1
+	schemaDefaultNumber = 2
+	schemaDefaultBool   = 3
+)
+
+var errSchemaTruncated = errors.New("schema: truncated buffer")
+
+// schemaReader decodes a serialized command tree
+type schemaReader struct {
+	data []byte
+	pos  int
+}
+
+func (r *schemaReader) u8() (byte, error) {
+	if r.pos+1 > len(r.data) {
+		return 0, errSchemaTruncated
+	}
+	v := r.data[r.pos]
+	r.pos++
+	return v, nil
+}
+
+func (r *schemaReader) u32() (uint32, error) {
+	if r.pos+4 > len(r.data) {
+		return 0, errSchemaTruncated
+	}
+	v := binary.LittleEndian.Uint32(r.data[r.pos:])
+	r.pos += 4
+	return v, nil
+}
+
+func (r *schemaReader) f64() (float64, error) {
+	if r.pos+8 > len(r.data) {
+		return 0, errSchemaTruncated
+	}
+	v := math.Float64frombits(binary.LittleEndian.Uint64(r.data[r.pos:]))
+	r.pos += 8
+	return v, nil
+}
+
+func (r *schemaReader) str() (string, error) {
+	n, err := r.u32()
+	if err != nil {
+		return "", err
+	}
+	if uint64(r.pos)+uint64(n) > uint64(len(r.data)) {
+		return "", errSchemaTruncated
+	}
+	s := string(r.data[r.pos : r.pos+int(n)])
+	r.pos += int(n)
+	return s, nil
+}
+
+// DecodeSchema rebuilds a command tree from its serialized form
+func DecodeSchema(data []byte) (*Command, error) {
+	if len(data) < len(schemaMagic) || string(data[:len(schemaMagic)]) != schemaMagic {
+		return nil, errors.New("schema: bad magic")
+	}
+
+	r := &schemaReader{data: data, pos: len(schemaMagic)}
+	cmd, err := r.command()
+	if err != nil {
+		return nil, err
+	}
+	if r.pos != len(data) {
+		return nil, errors.New("schema: trailing bytes")
+	}
+	return cmd, nil
+}
+
+func (r *schemaReader) command() (*Command, error) {
+	name, err := r.str()
+	if err != nil {
+		return nil, err
+	}
+	description, err := r.str()
+	if err != nil {
+		return nil, err
+	}
+	version, err := r.str()
+	if err != nil {
+		return nil, err
+	}
+	flags, err := r.u8()
+	if err != nil {
+		return nil, err
+	}
+	actionID, err := r.u32()
+	if err != nil {
+		return nil, err
+	}
+	configFile, err := r.str()
+	if err != nil {
+		return nil, err
+	}
+
+	cmd := NewCommand(name)
+	cmd.ActionID = actionID
+	cmd.ConfigFile = configFile
+	cmd.SetDescription(description)
+	if version != "" {
+		cmd.SetVersion(version)
+	}
+	cmd.AllowUnknownOption(flags&schemaAllowUnknown != 0)
+	cmd.AllowAbbreviatedCommands(flags&schemaAbbreviate != 0)
+	cmd.AllowResponseFiles(flags&schemaResponseFile != 0)
+
+	count, err := r.u32()
+	if err != nil {
+		return nil, err
+	}
+	// Every option takes at least four string lengths, a choice count and
+	// two kind bytes
+	if uint64(count)*22 > uint64(len(r.data)-r.pos) {
+		return nil, errSchemaTruncated
+	}
+	options := make([]*Option, count)
+	for i := range options {
+		if options[i], err = r.option(); err != nil {
+			return nil, err
+		}
+	}
+	// Conflicting flags stay with the option declared first; the host has
+	// no stderr to be warned on
+	cmd.AddOptions(options)
+
+	if count, err = r.u32(); err != nil {
+		return nil, err
+	}
+	for i := uint32(0); i < count; i++ {
+		argName, err := r.str()
+		if err != nil {
+			return nil, err
+		}
+		argDescription, err := r.str()
+		if err != nil {
+			return nil, err
+		}
+		choices, err := r.choices()
+		if err != nil {
+			return nil, err
+		}
+		cmd.AddArgument(NewArgument(argName, argDescription).SetChoices(choices))
+	}
+
+	if count, err = r.u32(); err != nil {
+		return nil, err
+	}
+	for i := uint32(0); i < count; i++ {
+		child, err := r.command()
+		if err != nil {
+			return nil, err
+		}
+		cmd.AddCommand(child)
+	}
+
+	return cmd, nil
+}
+
+func (r *schemaReader) option() (*Option, error) {
+	flags, err := r.str()
+	if err != nil {
+		return nil, err
+	}
+	description, err := r.str()
+	if err != nil {
+		return nil, err
+	}
+	option := NewOption(flags, description)
+
+	kind, err := r.u8()
+	if err != nil {
+		return nil, err
+	}
+	switch kind {
+	case schemaDefaultNone:
+	case schemaDefaultString:
+		value, err := r.str()
+		if err != nil {
+			return nil, err
+		}
+		option.SetDefault(value)
+	case schemaDefaultNumber:
+		value, err := r.f64()
+		if err != nil {
+			return nil, err
+		}
+		option.SetDefault(value)
+	case schemaDefaultBool:
+		value, err := r.u8()
+		if err != nil {
+			return nil, err
+		}
+		option.SetDefault(value != 0)
+	default:
+		return nil, errors.New("schema: unknown default kind")
+	}
+
+	if kind, err = r.u8(); err != nil {
+		return nil, err
+	}
+	if OptionKind(kind) > KindList {
+		return nil, errors.New("schema: unknown option kind")
+	}
+	option.SetKind(OptionKind(kind))
+
+	if option.Choices, err = r.choices(); err != nil {
+		return nil, err
+	}
+	if option.EnvVar, err = r.str(); err != nil {
+		return nil, err
+	}
+	if option.ConfigKey, err = r.str(); err != nil {
+		return nil, err
+	}
+	return option, nil
+}
+
+// choices reads a counted list of strings, nil if it is empty
+func (r *schemaReader) choices() ([]string, error) {
+	count, err := r.u32()
+	if err != nil || count == 0 {
+		return nil, err
+	}
+	// Every string takes at least its length word
+	if uint64(count)*4 > uint64(len(r.data)-r.pos) {
+		return nil, errSchemaTruncated
+	}
+	choices := make([]string, count)
+	for i := range choices {
+		if choices[i], err = r.str(); err != nil {
+			return nil, err
+		}
+	}
+	return choices, nil
+}
@@ -0,0 +1,122 @@
+package main
+
+import (
+	"encoding/binary"
+	"math"
+	"testing"
+)
+
+// f64 lets schemaWriter (see config.go) mirror the encoder in lib/schema.js
+func (w *schemaWriter) f64(v float64) {
+	w.buf = binary.LittleEndian.AppendUint64(w.buf, math.Float64bits(v))
+}
+
+func TestDecodeSchema(t *testing.T) {
+	w := &schemaWriter{buf: []byte(schemaMagic)}
+
+	// root
+	w.str("app")
+	w.str("An app")
+	w.str("1.2.3")
+	w.u8(schemaAbbreviate)
+	w.u32(0)
+	w.str("app.json")
+	w.u32(1)
+	w.str("-d, --debug")
+	w.str("Debug output")
+	w.u8(schemaDefaultBool)
+	w.u8(0)
+	w.u8(uint8(KindAuto))
+	w.u32(0)
+	w.str("")
+	w.str("")
+	w.u32(0)
+	w.u32(1)
+
+	// serve
+	w.str("serve")
+	w.str("Start the server")
+	w.str("")
+	w.u8(schemaAllowUnknown)
+	w.u32(7)
+	w.str("")
+	w.u32(2)
+	w.str("-p, --port <number>")
+	w.str("Port")
+	w.u8(schemaDefaultNumber)
+	w.f64(8080)
+	w.u8(uint8(KindInt))
+	w.u32(0)
+	w.str("APP_PORT")
+	w.str("server.port")
+	w.str("--host <host>")
+	w.str("Host")
+	w.u8(schemaDefaultString)
+	w.str("localhost")
+	w.u8(uint8(KindEnum))
+	w.u32(2)
+	w.str("localhost")
+	w.str("0.0.0.0")
+	w.str("")
+	w.str("")
+	w.u32(1)
+	w.str("[dir]")
+	w.str("Directory to serve")
+	w.u32(2)
+	w.str("public")
+	w.str("dist")
+	w.u32(0)
+
+	root, err := DecodeSchema(w.buf)
+	if err != nil {
+		t.Fatalf("DecodeSchema: %v", err)
+	}
+
+	if root.Name != "app" || root.Version != "1.2.3" || root.Description != "An app" || root.ConfigFile != "app.json" {
+		t.Fatalf("unexpected root: %+v", root)
+	}
+	if opt := root.FindOption("--debug"); opt == nil || opt.DefaultValue != false {
+		t.Fatalf("debug option not decoded: %+v", opt)
+	}
+
+	serve := root.FindCommand("serve")
+	if serve == nil || serve.Parent != root || !serve.AllowUnknown || serve.ActionID != 7 {
+		t.Fatalf("serve not decoded: %+v", serve)
+	}
+	if !root.AbbreviateCommands || root.FindCommand("se") != serve || serve.AbbreviateCommands {
+		t.Fatal("abbreviation flag not decoded")
+	}
+	if opt := serve.FindOption("-p"); opt == nil || !opt.Required || opt.DefaultValue != 8080.0 || opt.Kind != KindInt ||
+		opt.EnvVar != "APP_PORT" || opt.ConfigKey != "server.port" {
+		t.Fatalf("port option not decoded: %+v", opt)
+	}
+	if opt := serve.FindOption("--host"); opt == nil || opt.DefaultValue != "localhost" ||
+		opt.Kind != KindEnum || len(opt.Choices) != 2 || opt.Choices[1] != "0.0.0.0" {
+		t.Fatalf("host option not decoded: %+v", opt)
+	}
+	if len(serve.Arguments) != 1 || serve.Arguments[0].Name != "dir" || serve.Arguments[0].Required ||
+		len(serve.Arguments[0].Choices) != 2 {
+		t.Fatalf("argument not decoded: %+v", serve.Arguments)
+	}
+
+	result, err := root.ParseArgs([]string{"serve", "--port", "9000", "public"})
+	if err != nil {
+		t.Fatalf("ParseArgs: %v", err)
+	}
+	if result.Command != serve || result.Options["port"] != int64(9000) || result.Args[0] != "public" {
+		t.Fatalf("unexpected parse result: %+v", result)
+	}
+}
+
+func TestDecodeSchemaRejectsTruncated(t *testing.T) {
+	w := &schemaWriter{buf: []byte(schemaMagic)}
+	w.str("app")
+	w.u32(100)
+
+	if _, err := DecodeSchema(w.buf); err == nil {
+		t.Fatal("expected an error for a truncated schema")
+	}
+	if _, err := DecodeSchema([]byte("nope")); err == nil {
+		t.Fatal("expected an error for a bad magic")
+	}
+}
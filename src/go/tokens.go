@@ -0,0 +1,62 @@
+package main
+
+import "strings"
+
+// Before parsing, every argument is classified once by its leading bytes,
+// so the parse loop never re-scans an argument to decide what it is:
+//
+//	positional  "file.txt", "-" (standard input by convention), ""
+//	long        "--name"
+//	longValue   "--name=value", split at the '='
+//	short       "-x"
+//	cluster     "-abc": short flags given together; the first one that
+//	            takes a value takes the rest of the argument ("-j8")
+//	terminator  "--": every argument after it is positional
+//
+// Inline values are substrings of the argument, so they cost no copy.
+
+type tokenKind uint8
+
+const (
+	tokenPositional tokenKind = iota
+	tokenLong
+	tokenLongValue
+	tokenShort
+	tokenCluster
+	tokenTerminator
+)
+
+// argToken is the classification of one argument
+type argToken struct {
+	kind  tokenKind
+	split int32 // offset of the '=' of a longValue token
+}
+
+// classify returns the kind of arg
+func classify(arg string) argToken {
+	if len(arg) < 2 || arg[0] != '-' {
+		return argToken{kind: tokenPositional}
+	}
+	if arg[1] != '-' {
+		if len(arg) == 2 {
+			return argToken{kind: tokenShort}
+		}
+		return argToken{kind: tokenCluster}
+	}
+	if len(arg) == 2 {
+		return argToken{kind: tokenTerminator}
+	}
+	if eq := strings.IndexByte(arg, '='); eq > 2 {
+		return argToken{kind: tokenLongValue, split: int32(eq)}
+	}
+	return argToken{kind: tokenLong}
+}
+
+// tokenize classifies args into tokens, reusing its storage
+func tokenize(args []string, tokens []argToken) []argToken {
+	tokens = tokens[:0]
+	for _, arg := range args {
+		tokens = append(tokens, classify(arg))
+	}
+	return tokens
+}
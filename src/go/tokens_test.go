@@ -0,0 +1,165 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"reflect"
+	"testing"
+)
+
+func TestClassify(t *testing.T) {
+	tests := []struct {
+		arg  string
+		want argToken
+	}{
+		{"file.txt", argToken{kind: tokenPositional}},
+		{"-", argToken{kind: tokenPositional}},
+		{"", argToken{kind: tokenPositional}},
+		{"-v", argToken{kind: tokenShort}},
+		{"-abc", argToken{kind: tokenCluster}},
+		{"-j=8", argToken{kind: tokenCluster}},
+		{"--", argToken{kind: tokenTerminator}},
+		{"--name", argToken{kind: tokenLong}},
+		{"--name=value", argToken{kind: tokenLongValue, split: 6}},
+		{"--name=", argToken{kind: tokenLongValue, split: 6}},
+		{"--n=a=b", argToken{kind: tokenLongValue, split: 3}},
+		{"--=x", argToken{kind: tokenLong}},
+	}
+	for _, tt := range tests {
+		if got := classify(tt.arg); got != tt.want {
+			t.Errorf("classify(%q) = %+v, want %+v", tt.arg, got, tt.want)
+		}
+	}
+}
+
+func tokenTestCommand() (*Command, map[string]*Option) {
+	cmd, o := newTestCommand("tar",
+		NewOption("-x, --extract", "Extract"),
+		NewOption("-v, --verbose", "Verbosity").SetKind(KindCount),
+		NewOption("-f, --file <archive>", "Archive"),
+		NewOption("-j, --jobs <n>", "Jobs").SetKind(KindInt),
+		NewOption("--gzip", "Compress").SetKind(KindBool),
+	)
+	cmd.AddArgument(NewArgument("[paths...]", "Paths"))
+	return cmd, o
+}
+
+func TestTokenForms(t *testing.T) {
+	cmd, o := tokenTestCommand()
+	result, err := cmd.ParseArgs([]string{"-xvvf", "a.tar", "--jobs=8", "--file=b=c.tar", "--gzip=false",
+		"-", "--", "-v", "--jobs"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !result.Bool(o["extract"]) || result.Int(o["verbose"]) != 2 || result.String(o["file"]) != "b=c.tar" ||
+		result.Int(o["jobs"]) != 8 || !result.IsSet(o["gzip"]) || result.Bool(o["gzip"]) {
+		t.Errorf("values %v", result.Values())
+	}
+	if !reflect.DeepEqual(result.Args, []string{"-", "-v", "--jobs"}) || !reflect.DeepEqual(result.ArgIndexes, []int{5, 7, 8}) {
+		t.Errorf("args %q at %v", result.Args, result.ArgIndexes)
+	}
+	want := []OptionValue{
+		{o["extract"], -1, 0}, {o["verbose"], -1, 0}, {o["verbose"], -1, 0}, {o["file"], 1, 0},
+		{o["jobs"], 2, 7}, {o["file"], 3, 7}, {o["gzip"], -1, 0},
+	}
+	if !reflect.DeepEqual(result.Set, want) {
+		t.Errorf("set %+v", result.Set)
+	}
+
+	// A value-taking letter takes the rest of its cluster
+	result, err = cmd.ParseArgs([]string{"-vj16", "-vfout.tar"})
+	if err != nil || result.Int(o["jobs"]) != 16 || result.String(o["file"]) != "out.tar" || result.Int(o["verbose"]) != 2 {
+		t.Errorf("%v: %v", err, result.Values())
+	}
+}
+
+func TestTokenErrors(t *testing.T) {
+	cmd, _ := tokenTestCommand()
+	tests := []struct {
+		args    []string
+		code    ErrorCode
+		index   int
+		message string
+	}{
+		{[]string{"-xq"}, ErrUnknownOption, 0, "unknown option '-xq'"},
+		{[]string{"--color=auto"}, ErrUnknownOption, 0, "unknown option '--color=auto'"},
+		{[]string{"--help=me"}, ErrUnknownOption, 0, "unknown option '--help=me'"},
+		{[]string{"-xf"}, ErrMissingOptionArgument, 0, "option '-xf' missing argument"},
+		{[]string{"a", "--jobs=many"}, ErrInvalidOptionValue, 1, "option '--jobs' argument 'many' is invalid"},
+		{[]string{"-vjmany"}, ErrInvalidOptionValue, 0, "option '-j' argument 'many' is invalid"},
+		{[]string{"-vj", "many"}, ErrInvalidOptionValue, 0, "option '-j' argument 'many' is invalid"},
+	}
+	for _, tt := range tests {
+		_, err := cmd.ParseArgs(tt.args)
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) || parseErr.Code != tt.code || parseErr.Index != tt.index || err.Error() != tt.message {
+			t.Errorf("%v: got %v (%+v)", tt.args, err, parseErr)
+		}
+	}
+
+	// Unknown forms are positional when the command allows unknown options
+	cmd.AllowUnknownOption(true)
+	result, err := cmd.ParseArgs([]string{"-xq", "--color=auto", "-x"})
+	if err != nil || !reflect.DeepEqual(result.Args, []string{"-xq", "--color=auto"}) || len(result.Set) != 1 {
+		t.Errorf("%v: args %q", err, result.Args)
+	}
+}
+
+// TestEncodeInlineValues pins the words the inline value check in
+// test/advanced-test.js decodes
+func TestEncodeInlineValues(t *testing.T) {
+	cmd, _ := tokenTestCommand()
+	result, err := cmd.ParseArgs([]string{"-xvfa.tar", "--jobs=4", "--file=b.tar"})
+	out := make([]uint32, 32)
+	if status := encodeResult(out, result, err); status != uint32(ErrNone) {
+		t.Fatalf("status %d (%v)", status, err)
+	}
+	want := []uint32{
+		0, 26, resultNone, 0, 5, 0,
+		0, resultNone, 1, resultNone, 2, 0, 3, 1, 2, 2,
+		1, 0, 1, 0, 4, 0, 4, 0, 7, 0,
+	}
+	if !reflect.DeepEqual(out[:len(want)], want) {
+		t.Errorf("words = %v\nwant    %v", out[:len(want)], want)
+	}
+}
+
+func TestTokenParseAllocations(t *testing.T) {
+	if raceEnabled {
+		t.Skip("sync.Pool drops items under the race detector")
+	}
+	cmd, o := tokenTestCommand()
+	args := []string{"-xvvf", "a.tar", "--jobs=8", "--", "b"}
+	allocs := testing.AllocsPerRun(100, func() {
+		result, err := cmd.ParseArgsPooled(args)
+		if err != nil || result.Int(o["jobs"]) != 8 {
+			t.Fatal(err)
+		}
+		result.Release()
+	})
+	if allocs != 0 {
+		t.Errorf("%v allocations per parse", allocs)
+	}
+}
+
+// BenchmarkTokenizedParse parses an argv of n entries mixing every form
+func BenchmarkTokenizedParse(b *testing.B) {
+	cmd, _ := tokenTestCommand()
+	for _, n := range []int{10, 100000} {
+		args := make([]string, 0, n)
+		for len(args) < n {
+			args = append(args, "-xv", "--jobs=4", "-fout.tar", fmt.Sprintf("path/%d", len(args)), "--file", "x.tar")
+		}
+		args = args[:n]
+		b.Run(fmt.Sprintf("args=%d", n), func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				result, err := cmd.ParseArgsPooled(args)
+				if err != nil {
+					b.Fatal(err)
+				}
+				result.Release()
+			}
+		})
+	}
+}
@@ -0,0 +1,160 @@
+package main
+
+// commandTrie indexes the names and aliases of a command's subcommands for
+// dispatch. It is a radix trie: edges carry whole label fragments, so a
+// lookup touches one node per distinct branch point rather than one per
+// byte, and every node records which subcommand (if just one) lies below
+// it, which answers unique-prefix lookups without visiting the subtree.
+type commandTrie struct {
+	root *trieNode
+}
+
+const (
+	trieNone      = -1 // no subcommand below a node
+	trieAmbiguous = -2 // several subcommands below a node
+)
+
+type trieNode struct {
+	label    string      // edge label from the parent
+	children []*trieNode // sorted by the first byte of their labels
+	command  int         // subcommand whose name ends here, or trieNone
+	below    int         // only subcommand at or below this node, trieNone or trieAmbiguous
+}
+
+func newTrieNode(label string) *trieNode {
+	return &trieNode{label: label, command: trieNone, below: trieNone}
+}
+
+func (n *trieNode) mark(command int) {
+	if n.below == trieNone {
+		n.below = command
+	} else if n.below != command {
+		n.below = trieAmbiguous
+	}
+}
+
+// child returns the position of the child whose label starts with b, or the
+// position where such a child would be inserted
+func (n *trieNode) child(b byte) (int, bool) {
+	lo, hi := 0, len(n.children)
+	for lo < hi {
+		mid := int(uint(lo+hi) >> 1)
+		if n.children[mid].label[0] < b {
+			lo = mid + 1
+		} else {
+			hi = mid
+		}
+	}
+	return lo, lo < len(n.children) && n.children[lo].label[0] == b
+}
+
+// insert maps key to a subcommand index. A key that is already present
+// keeps its first subcommand, matching the old in-order scan, and the
+// shadowed one does not make prefixes of key ambiguous.
+func (t *commandTrie) insert(key string, command int) {
+	if t.root == nil {
+		t.root = newTrieNode("")
+	}
+	if t.lookup(key, false) >= 0 {
+		return
+	}
+	node := t.root
+	node.mark(command)
+	for key != "" {
+		i, found := node.child(key[0])
+		if !found {
+			leaf := newTrieNode(key)
+			leaf.command = command
+			leaf.below = command
+			node.children = append(node.children, nil)
+			copy(node.children[i+1:], node.children[i:])
+			node.children[i] = leaf
+			return
+		}
+
+		next := node.children[i]
+		common := commonPrefix(key, next.label)
+		if common < len(next.label) {
+			// Split the edge at the point where key diverges
+			split := newTrieNode(next.label[:common])
+			split.below = next.below
+			next.label = next.label[common:]
+			split.children = []*trieNode{next}
+			node.children[i] = split
+			next = split
+		}
+		next.mark(command)
+		node = next
+		key = key[common:]
+	}
+	node.command = command
+}
+
+// lookup returns the subcommand registered under key, or, with prefix set,
+// the only subcommand that has a name or alias starting with key. It
+// returns -1 if there is no such subcommand.
+func (t *commandTrie) lookup(key string, prefix bool) int {
+	node := t.root
+	if node == nil {
+		return -1
+	}
+	for key != "" {
+		i, found := node.child(key[0])
+		if !found {
+			return -1
+		}
+		next := node.children[i]
+		if len(key) < len(next.label) {
+			// key ends inside this edge; only a prefix lookup can match
+			if prefix && next.label[:len(key)] == key && next.below >= 0 {
+				return next.below
+			}
+			return -1
+		}
+		if key[:len(next.label)] != next.label {
+			return -1
+		}
+		node = next
+		key = key[len(next.label):]
+	}
+	if node.command >= 0 {
+		return node.command
+	}
+	if prefix && node != t.root && node.below >= 0 {
+		return node.below
+	}
+	return -1
+}
+
+func commonPrefix(a, b string) int {
+	n := len(a)
+	if len(b) < n {
+		n = len(b)
+	}
+	for i := 0; i < n; i++ {
+		if a[i] != b[i] {
+			return i
+		}
+	}
+	return n
+}
+
+// prefixes calls fn for every non-empty prefix of an indexed key that only
+// one subcommand's names and aliases start with
+func (t *commandTrie) prefixes(fn func(prefix string, command int)) {
+	if t.root != nil {
+		t.root.prefixes("", fn)
+	}
+}
+
+func (n *trieNode) prefixes(path string, fn func(prefix string, command int)) {
+	for _, child := range n.children {
+		full := path + child.label
+		if child.below >= 0 {
+			for end := len(path) + 1; end <= len(full); end++ {
+				fn(full[:end], child.below)
+			}
+		}
+		child.prefixes(full, fn)
+	}
+}
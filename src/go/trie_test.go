@@ -0,0 +1,83 @@
+package main
+
+import (
+	"fmt"
+	"testing"
+)
+
+func TestFindCommandIndex(t *testing.T) {
+	root := NewCommand("app")
+	deploy := NewCommand("deploy").SetAliases([]string{"ship"})
+	root.AddCommand(deploy)
+	root.AddCommand(NewCommand("delete"))
+	root.AddCommand(NewCommand("dep"))
+	root.AddCommand(NewCommand("list").SetAliases([]string{"ls"}))
+	root.AddCommand(NewCommand("deploy")) // shadowed by the first deploy
+
+	exact := map[string]int{"deploy": 0, "ship": 0, "delete": 1, "dep": 2, "list": 3, "ls": 3}
+	for name, want := range exact {
+		if got := root.findCommandIndex(name); got != want {
+			t.Errorf("findCommandIndex(%q) = %d, want %d", name, got, want)
+		}
+	}
+	if root.findCommandIndex("depl") != -1 {
+		t.Error("prefix matched without AbbreviateCommands")
+	}
+
+	root.AllowAbbreviatedCommands(true)
+	abbreviated := map[string]int{
+		"dep":  2,  // an exact name beats being a prefix of deploy
+		"depl": 0,  // unique prefix
+		"del":  1,  // unique prefix
+		"de":   -1, // deploy, delete and dep
+		"l":    3,  // list and ls are the same command
+		"sh":   0,  // prefix of an alias
+		"x":    -1,
+		"":     -1,
+	}
+	for name, want := range abbreviated {
+		if got := root.findCommandIndex(name); got != want {
+			t.Errorf("abbreviated findCommandIndex(%q) = %d, want %d", name, got, want)
+		}
+	}
+
+	// Aliases set after the command was attached reach the index, and
+	// dropped aliases leave it
+	deploy.SetAliases([]string{"ship", "push"})
+	if root.findCommandIndex("push") != 0 {
+		t.Error("added alias not indexed")
+	}
+	deploy.SetAliases(nil)
+	if root.findCommandIndex("ship") != -1 || root.findCommandIndex("deploy") != 0 {
+		t.Error("index not rebuilt after removing aliases")
+	}
+}
+
+// BenchmarkFindCommand dispatches to the last-added of many subcommands,
+// the worst case of a scan in declaration order
+func BenchmarkFindCommand(b *testing.B) {
+	for _, count := range []int{10, 1000, 100000} {
+		root := NewCommand("plugins")
+		for i := 0; i < count; i++ {
+			root.AddCommand(NewCommand(fmt.Sprintf("plugin-%d", i)).SetAliases([]string{fmt.Sprintf("p%d", i)}))
+		}
+		root.AllowAbbreviatedCommands(true)
+		last := fmt.Sprintf("plugin-%d", count-1)
+		alias := fmt.Sprintf("p%d", count-1)
+
+		b.Run(fmt.Sprintf("exact/commands=%d", count), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				if root.FindCommand(last) == nil {
+					b.Fatal("miss")
+				}
+			}
+		})
+		b.Run(fmt.Sprintf("alias/commands=%d", count), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				if root.FindCommand(alias) == nil {
+					b.Fatal("miss")
+				}
+			}
+		})
+	}
+}
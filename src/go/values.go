@@ -0,0 +1,496 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"strconv"
+	"strings"
+	"time"
+)
+
+// OptionKind is the type of value an option holds. Values are converted
+// once while parsing and kept in typed lanes of the result, so callers
+// neither type-assert nor convert on every use.
+type OptionKind uint8
+
+const (
+	KindAuto       OptionKind = iota // string if the option takes a value, bool otherwise
+	KindBool                         // flag, or a value accepted by strconv.ParseBool
+	KindInt                          // int64, in any base strconv.ParseInt accepts with base 0
+	KindFloat                        // float64
+	KindString                       // string
+	KindStringList                   // every value given, in order
+	KindCount                        // number of times the flag was given
+	KindDuration                     // time.Duration, in time.ParseDuration syntax
+	KindBytes                        // byte size such as "512", "64MiB" or "1.5GB", see ParseBytes
+	KindEnum                         // one of the option's Choices
+	KindList                         // comma-separated strings, accumulated over repeats
+)
+
+// SetKind sets the type of value the option holds
+func (o *Option) SetKind(kind OptionKind) *Option {
+	o.Kind = kind
+	return o
+}
+
+// kind returns the option's kind with KindAuto resolved
+func (o *Option) kind() OptionKind {
+	if o.Kind != KindAuto {
+		return o.Kind
+	}
+	if o.Required || o.Optional {
+		return KindString
+	}
+	return KindBool
+}
+
+// SlotValues holds the typed option values of a parse result as a
+// struct of arrays. Each option of the matched command is identified by
+// its slot ID; its value lives in the lane of its kind at the position
+// the compiled program assigned it. present marks which slots were given
+// on the command line, so only the bits are cleared between parses and
+// options left out fall back to their precompiled defaults.
+type SlotValues struct {
+	present []uint64
+	ints    []int64 // bool (0 or 1), int, count, duration, byte size and enum index
+	floats  []float64
+	strings []string
+	lists   [][]string
+	custom  []interface{} // results of Option.Parser
+}
+
+// slotLane is the kind of storage a lane provides
+type slotLane uint8
+
+const (
+	laneInt slotLane = iota
+	laneFloat
+	laneString
+	laneList
+	laneCustom
+	laneKinds
+)
+
+// slotSpec is the compiled form of one option slot. It holds no pointers
+// (see layout.go): the option, its choices and parser are indexes of the
+// Program's side arrays, whose first entries are nil so a zero spec names
+// none of them, and its defaults are in the Program's text and defaults.
+type slotSpec struct {
+	kind    OptionKind
+	lane    int32
+	option  int32 // in Program.options
+	choices int32 // in Program.choices
+	parser  int32 // in Program.parsers
+	custom  int32 // position in the custom lane when parser is set
+
+	defInt    int64
+	defFloat  float64
+	defString textRef
+	defList   span // of Program.defaults
+}
+
+func laneOf(kind OptionKind) slotLane {
+	switch kind {
+	case KindFloat:
+		return laneFloat
+	case KindString:
+		return laneString
+	case KindStringList, KindList:
+		return laneList
+	}
+	return laneInt
+}
+
+// newSlotSpec compiles an option's kind and default; the option is
+// p.options[option]. A default that does not convert to the option's kind
+// is ignored.
+func (p *Program) newSlotSpec(opt *Option, option, lane, custom int32) slotSpec {
+	spec := slotSpec{kind: opt.kind(), lane: lane, option: option, custom: custom}
+	choices := newChoiceSet(opt.Choices)
+	if choices != nil {
+		spec.choices = int32(len(p.choices))
+		p.choices = append(p.choices, choices)
+	}
+	if opt.Parser != nil {
+		spec.parser = int32(len(p.parsers))
+		p.parsers = append(p.parsers, opt.Parser)
+	}
+	spec.defList.start = uint32(len(p.defaults))
+	switch value := opt.DefaultValue.(type) {
+	case nil:
+	case string:
+		spec.defString = p.intern(value)
+		if spec.kind == KindList {
+			p.defaults = appendList(p.defaults, value)
+		} else {
+			p.defaults = append(p.defaults, value)
+		}
+		spec.defInt, spec.defFloat, _ = spec.convert(value, choices)
+	case time.Duration:
+		spec.defInt = int64(value)
+	case bool:
+		if value {
+			spec.defInt = 1
+		}
+	case int:
+		spec.defInt, spec.defFloat = int64(value), float64(value)
+	case int64:
+		spec.defInt, spec.defFloat = value, float64(value)
+	case float64:
+		spec.defInt, spec.defFloat = int64(value), value
+	case []string:
+		p.defaults = append(p.defaults, value...)
+	}
+	spec.defList.end = uint32(len(p.defaults))
+	return spec
+}
+
+// choiceSet returns the compiled choices of a slot, nil if it has none
+func (p *Program) choiceSet(spec *slotSpec) *choiceSet {
+	return p.choices[spec.choices]
+}
+
+// defaultList returns the default of a list slot. Appending to a list
+// value must never write into the defaults, hence the capped slice.
+func (p *Program) defaultList(spec *slotSpec) []string {
+	if spec.defList.len() == 0 {
+		return nil
+	}
+	return p.defaults[spec.defList.start:spec.defList.end:spec.defList.end]
+}
+
+// errNotAChoice is the cause of ErrInvalidChoice
+var errNotAChoice = errors.New("not one of the allowed choices")
+
+// convert converts a command-line value for a scalar kind; choices are
+// those of the slot
+func (spec *slotSpec) convert(value string, choices *choiceSet) (int64, float64, error) {
+	switch spec.kind {
+	case KindBool:
+		b, err := strconv.ParseBool(value)
+		if b {
+			return 1, 0, err
+		}
+		return 0, 0, err
+	case KindInt, KindCount:
+		i, err := strconv.ParseInt(value, 0, 64)
+		return i, 0, err
+	case KindFloat:
+		f, err := strconv.ParseFloat(value, 64)
+		return 0, f, err
+	case KindDuration:
+		d, err := time.ParseDuration(value)
+		return int64(d), 0, err
+	case KindBytes:
+		n, err := ParseBytes(value)
+		return n, 0, err
+	case KindEnum:
+		i := -1
+		if choices != nil {
+			i = choices.find(value)
+		}
+		if i < 0 {
+			return -1, 0, choices.miss(value)
+		}
+		return int64(i), 0, nil
+	}
+	return 0, 0, nil
+}
+
+// appendList appends the comma-separated items of value to list. The
+// items are substrings of value, so nothing is copied.
+func appendList(list []string, value string) []string {
+	for {
+		i := strings.IndexByte(value, ',')
+		if i < 0 {
+			return append(list, value)
+		}
+		list = append(list, value[:i])
+		value = value[i+1:]
+	}
+}
+
+// reset prepares the values for a command with the given number of slots
+func (v *SlotValues) reset(slots int) {
+	words := (slots + 63) / 64
+	if cap(v.present) < words {
+		v.present = make([]uint64, words)
+	}
+	v.present = v.present[:words]
+	clear(v.present)
+}
+
+// reserve makes sure every lane has room for the program's largest command
+func (v *SlotValues) reserve(lanes [laneKinds]int) {
+	if len(v.ints) < lanes[laneInt] {
+		v.ints = make([]int64, lanes[laneInt])
+	}
+	if len(v.floats) < lanes[laneFloat] {
+		v.floats = make([]float64, lanes[laneFloat])
+	}
+	if len(v.strings) < lanes[laneString] {
+		v.strings = make([]string, lanes[laneString])
+	}
+	if len(v.lists) < lanes[laneList] {
+		v.lists = make([][]string, lanes[laneList])
+	}
+	if len(v.custom) < lanes[laneCustom] {
+		v.custom = make([]interface{}, lanes[laneCustom])
+	}
+}
+
+func (v *SlotValues) isSet(slot int) bool {
+	return slot >= 0 && slot/64 < len(v.present) && v.present[slot/64]&(1<<(slot%64)) != 0
+}
+
+// store records one occurrence of an option of p. value is ignored for
+// flags that take no value. The option's Parser, if any, runs after the
+// value converted to its kind.
+func (v *SlotValues) store(slot int, p *Program, spec *slotSpec, value string, hasValue bool) error {
+	first := !v.isSet(slot)
+	v.present[slot/64] |= 1 << (slot % 64)
+	// Strings with choices are checked here; enums while converting
+	choices := p.choiceSet(spec)
+	if choices != nil && hasValue && (spec.kind == KindString || spec.kind == KindStringList) &&
+		choices.find(value) < 0 {
+		return choices.miss(value)
+	}
+
+	switch spec.kind {
+	case KindString:
+		v.strings[spec.lane] = value
+	case KindStringList, KindList:
+		if first {
+			v.lists[spec.lane] = v.lists[spec.lane][:0]
+		}
+		if spec.kind == KindStringList {
+			v.lists[spec.lane] = append(v.lists[spec.lane], value)
+			break
+		}
+		start := len(v.lists[spec.lane])
+		v.lists[spec.lane] = appendList(v.lists[spec.lane], value)
+		if choices != nil {
+			for _, item := range v.lists[spec.lane][start:] {
+				if choices.find(item) < 0 {
+					return choices.miss(item)
+				}
+			}
+		}
+	case KindCount:
+		if hasValue {
+			// A count given as a number, as environment variables do
+			i, _, err := spec.convert(value, choices)
+			if err != nil {
+				return err
+			}
+			v.ints[spec.lane] = i
+			break
+		}
+		if first {
+			v.ints[spec.lane] = 0
+		}
+		v.ints[spec.lane]++
+	case KindFloat:
+		_, f, err := spec.convert(value, choices)
+		if err != nil {
+			return err
+		}
+		v.floats[spec.lane] = f
+	default:
+		if spec.kind == KindBool && !hasValue {
+			v.ints[spec.lane] = 1
+			break
+		}
+		i, _, err := spec.convert(value, choices)
+		if err != nil {
+			return err
+		}
+		v.ints[spec.lane] = i
+	}
+
+	if spec.parser != 0 && hasValue {
+		parsed, err := p.parsers[spec.parser](value)
+		if err != nil {
+			return err
+		}
+		v.custom[spec.custom] = parsed
+	}
+	return nil
+}
+
+// spec returns the compiled slot of opt in the matched command, or nil if
+// opt does not belong to it
+func (r *ParseResult) spec(opt *Option) *slotSpec {
+	if r.program == nil {
+		return nil
+	}
+	slots := r.program.stateSlots(&r.program.states[r.state])
+	if opt.Slot < 0 || opt.Slot >= len(slots) || r.program.options[slots[opt.Slot].option] != opt {
+		return nil
+	}
+	return &slots[opt.Slot]
+}
+
+// IsSet reports whether opt was given on the command line
+func (r *ParseResult) IsSet(opt *Option) bool {
+	return r.spec(opt) != nil && r.Slots.isSet(opt.Slot)
+}
+
+// Bool returns the value of a bool option
+func (r *ParseResult) Bool(opt *Option) bool {
+	return r.Int(opt) != 0
+}
+
+// Int returns the value of an option held as an integer: bool, int,
+// count, duration (in nanoseconds), byte size, or enum (the index of the
+// choice)
+func (r *ParseResult) Int(opt *Option) int64 {
+	spec := r.spec(opt)
+	if spec == nil {
+		return 0
+	}
+	if r.Slots.isSet(opt.Slot) && laneOf(spec.kind) == laneInt {
+		return r.Slots.ints[spec.lane]
+	}
+	return spec.defInt
+}
+
+// Float returns the value of a float option
+func (r *ParseResult) Float(opt *Option) float64 {
+	spec := r.spec(opt)
+	if spec == nil {
+		return 0
+	}
+	if r.Slots.isSet(opt.Slot) && spec.kind == KindFloat {
+		return r.Slots.floats[spec.lane]
+	}
+	return spec.defFloat
+}
+
+// Duration returns the value of a duration option
+func (r *ParseResult) Duration(opt *Option) time.Duration {
+	return time.Duration(r.Int(opt))
+}
+
+// String returns the value of a string or enum option
+func (r *ParseResult) String(opt *Option) string {
+	spec := r.spec(opt)
+	if spec == nil {
+		return ""
+	}
+	if spec.kind == KindEnum {
+		choices := r.program.choiceSet(spec)
+		if i := r.Int(opt); choices != nil && i >= 0 && i < int64(len(choices.values)) &&
+			(r.Slots.isSet(opt.Slot) || spec.defString.len != 0) {
+			return choices.values[i]
+		}
+		return ""
+	}
+	if r.Slots.isSet(opt.Slot) && spec.kind == KindString {
+		return r.Slots.strings[spec.lane]
+	}
+	return r.program.str(spec.defString)
+}
+
+// Strings returns the values of a string list or comma list option. For
+// pooled results the slice is only valid until Release.
+func (r *ParseResult) Strings(opt *Option) []string {
+	spec := r.spec(opt)
+	if spec == nil {
+		return nil
+	}
+	if r.Slots.isSet(opt.Slot) && laneOf(spec.kind) == laneList {
+		return r.Slots.lists[spec.lane]
+	}
+	return r.program.defaultList(spec)
+}
+
+// Parsed returns what the option's Parser made of its value, or the
+// option's DefaultValue if it was not given
+func (r *ParseResult) Parsed(opt *Option) interface{} {
+	spec := r.spec(opt)
+	if spec == nil || spec.parser == 0 {
+		return nil
+	}
+	if r.Slots.isSet(opt.Slot) && r.Slots.custom[spec.custom] != nil {
+		return r.Slots.custom[spec.custom]
+	}
+	return opt.DefaultValue
+}
+
+// value returns the typed value of an option of the matched command as an
+// interface{}, and whether it was set or has a default
+func (r *ParseResult) value(opt *Option) (interface{}, bool) {
+	spec := r.spec(opt)
+	if spec == nil {
+		return nil, false
+	}
+	if !r.Slots.isSet(opt.Slot) && opt.DefaultValue == nil {
+		return nil, false
+	}
+	if spec.parser != 0 {
+		if parsed := r.Parsed(opt); parsed != nil {
+			return parsed, true
+		}
+	}
+	switch spec.kind {
+	case KindBool:
+		if opt.Kind == KindAuto && !r.Slots.isSet(opt.Slot) {
+			return opt.DefaultValue, true
+		}
+		return r.Bool(opt), true
+	case KindInt, KindCount, KindBytes:
+		return r.Int(opt), true
+	case KindDuration:
+		return r.Duration(opt), true
+	case KindFloat:
+		return r.Float(opt), true
+	case KindStringList, KindList:
+		// Copied, since map values may outlive a pooled result
+		return append([]string(nil), r.Strings(opt)...), true
+	}
+	if opt.Kind == KindAuto && !r.Slots.isSet(opt.Slot) {
+		return opt.DefaultValue, true
+	}
+	return r.String(opt), true
+}
+
+// invalidValue builds the error for a value of the option in slot that
+// does not convert to its kind, is not one of its choices, or that its
+// Parser rejected
+func invalidValue(index int, flag, value string, slot int, cause error) *ParseError {
+	err := &ParseError{Code: ErrInvalidOptionValue, Index: index, Token: flag, Value: value, Err: cause, owner: slot}
+	if errors.Is(cause, errNotAChoice) {
+		err.Code = ErrInvalidChoice
+		err.suggest(cause)
+	}
+	return err
+}
+
+func (k OptionKind) String() string {
+	switch k {
+	case KindAuto:
+		return "auto"
+	case KindBool:
+		return "bool"
+	case KindInt:
+		return "int"
+	case KindFloat:
+		return "float"
+	case KindString:
+		return "string"
+	case KindStringList:
+		return "string list"
+	case KindCount:
+		return "count"
+	case KindDuration:
+		return "duration"
+	case KindBytes:
+		return "bytes"
+	case KindEnum:
+		return "enum"
+	case KindList:
+		return "list"
+	}
+	return fmt.Sprintf("OptionKind(%d)", uint8(k))
+}
@@ -0,0 +1,165 @@
+package main
+
+import (
+	"errors"
+	"reflect"
+	"testing"
+)
+
+type typedOptions struct {
+	cmd                                           *Command
+	verbose, retries, ratio, name, tag, debug, lz *Option
+}
+
+func typedTestCommand() typedOptions {
+	o := typedOptions{cmd: NewCommand("app")}
+	o.verbose = NewOption("-v, --verbose", "Verbosity").SetKind(KindCount)
+	o.retries = NewOption("-r, --retries <n>", "Retries").SetKind(KindInt).SetDefault(3)
+	o.ratio = NewOption("--ratio <x>", "Ratio").SetKind(KindFloat).SetDefault(0.5)
+	o.name = NewOption("-n, --name <name>", "Name").SetDefault("anon")
+	o.tag = NewOption("-t, --tag <tag>", "Tags").SetKind(KindStringList)
+	o.debug = NewOption("--debug [on]", "Debug").SetKind(KindBool)
+	o.lz = NewOption("--lz", "Compress")
+	for _, opt := range []*Option{o.verbose, o.retries, o.ratio, o.name, o.tag, o.debug, o.lz} {
+		o.cmd.AddOption(opt)
+	}
+	return o
+}
+
+func TestTypedValues(t *testing.T) {
+	o := typedTestCommand()
+	result, err := o.cmd.ParseArgs([]string{"-v", "-v", "-r", "0x10", "--ratio", "1.25",
+		"-t", "a", "--tag", "b", "--debug", "false", "--lz", "-n", "x"})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if got := result.Int(o.verbose); got != 2 {
+		t.Errorf("verbose = %d, want 2", got)
+	}
+	if got := result.Int(o.retries); got != 16 {
+		t.Errorf("retries = %d, want 16", got)
+	}
+	if got := result.Float(o.ratio); got != 1.25 {
+		t.Errorf("ratio = %v, want 1.25", got)
+	}
+	if got := result.Strings(o.tag); !reflect.DeepEqual(got, []string{"a", "b"}) {
+		t.Errorf("tag = %v, want [a b]", got)
+	}
+	if result.Bool(o.debug) || !result.IsSet(o.debug) {
+		t.Error("debug should be set to false")
+	}
+	if !result.Bool(o.lz) || result.String(o.name) != "x" {
+		t.Errorf("lz = %v, name = %q", result.Bool(o.lz), result.String(o.name))
+	}
+
+	want := map[string]interface{}{"verbose": int64(2), "retries": int64(16), "ratio": 1.25,
+		"name": "x", "tag": []string{"a", "b"}, "debug": false, "lz": true}
+	if got := result.Values(); !reflect.DeepEqual(got, want) {
+		t.Errorf("Values() = %v, want %v", got, want)
+	}
+}
+
+func TestTypedDefaults(t *testing.T) {
+	o := typedTestCommand()
+	result, err := o.cmd.ParseArgs(nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if result.IsSet(o.retries) || result.Int(o.retries) != 3 || result.Float(o.ratio) != 0.5 ||
+		result.String(o.name) != "anon" || result.Strings(o.tag) != nil {
+		t.Errorf("unexpected defaults: %d %v %q %v", result.Int(o.retries), result.Float(o.ratio),
+			result.String(o.name), result.Strings(o.tag))
+	}
+	// Options without a kind keep their declared default in Values
+	want := map[string]interface{}{"retries": int64(3), "ratio": 0.5, "name": "anon"}
+	if got := result.Values(); !reflect.DeepEqual(got, want) {
+		t.Errorf("Values() = %v, want %v", got, want)
+	}
+
+	// Options of other commands have no value in this result
+	other := NewOption("-r, --retries <n>", "Retries").SetKind(KindInt).SetDefault(9)
+	NewCommand("other").AddOption(other)
+	if result.Int(other) != 0 {
+		t.Error("option of another command resolved in result")
+	}
+}
+
+func TestInvalidOptionValue(t *testing.T) {
+	o := typedTestCommand()
+	for _, args := range [][]string{
+		{"-n", "x", "--retries", "many"},
+		{"-n", "x", "--ratio", "half"},
+		{"-n", "x", "--debug", "maybe"},
+	} {
+		_, err := o.cmd.ParseArgs(args)
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) || parseErr.Code != ErrInvalidOptionValue {
+			t.Errorf("%v: got %v, want ErrInvalidOptionValue", args, err)
+			continue
+		}
+		if parseErr.Index != 2 || parseErr.Token != args[2] || parseErr.Value != args[3] {
+			t.Errorf("%v: got %+v", args, parseErr)
+		}
+	}
+}
+
+// A value-less option of a kind that needs a value cannot be given bare,
+// and must not leave a value from an earlier parse of the same result
+func TestValuelessTypedOption(t *testing.T) {
+	cmd := NewCommand("app")
+	level := NewOption("-l, --level", "Level").SetKind(KindInt)
+	quiet := NewOption("-q, --quiet", "Quiet")
+	cmd.AddOption(level)
+	cmd.AddOption(quiet)
+	program := cmd.compiled()
+	result := program.acquireResult()
+	defer result.Release()
+
+	if err := program.parse([]string{"--level=7"}, result); err != nil || result.Int(level) != 7 {
+		t.Fatalf("--level=7: level = %d, err = %v", result.Int(level), err)
+	}
+	for _, args := range [][]string{{"--level"}, {"-ql"}} {
+		err := program.parse(args, result)
+		var parseErr *ParseError
+		if !errors.As(err, &parseErr) || parseErr.Code != ErrInvalidOptionValue || parseErr.Index != 0 {
+			t.Errorf("%v: got %v, want ErrInvalidOptionValue", args, err)
+		}
+	}
+}
+
+func TestTypedParseAllocations(t *testing.T) {
+	if raceEnabled {
+		t.Skip("sync.Pool drops items under the race detector")
+	}
+	o := typedTestCommand()
+	args := []string{"-v", "-v", "-r", "7", "--ratio", "2", "-t", "a", "-t", "b", "--lz"}
+	allocs := testing.AllocsPerRun(100, func() {
+		result, err := o.cmd.ParseArgsPooled(args)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if result.Int(o.verbose) != 2 || len(result.Strings(o.tag)) != 2 {
+			t.Fatal("wrong values")
+		}
+		result.Release()
+	})
+	if allocs != 0 {
+		t.Errorf("typed ParseArgsPooled: %v allocations per parse", allocs)
+	}
+}
+
+func BenchmarkTypedParse(b *testing.B) {
+	o := typedTestCommand()
+	args := []string{"-v", "-r", "7", "--ratio", "2", "-t", "a", "-n", "x"}
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		result, err := o.cmd.ParseArgsPooled(args)
+		if err != nil {
+			b.Fatal(err)
+		}
+		if result.Int(o.retries) != 7 {
+			b.Fatal("wrong value")
+		}
+		result.Release()
+	}
+}
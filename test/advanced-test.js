@@ -105,4 +105,244 @@ try {
   console.log("  ✗ Unexpected error:", error.message, "\n");
 }
 
+// Test 8: Typed option values
+console.log("Test 8: Typed option values");
+{
+  const { ParseResult } = require("../lib/result");
+  const typedCmd = new Command("typed-test");
+  typedCmd
+    .option("-v, --verbose", "Verbosity", undefined, { kind: "count" })
+    .option("--timeout <duration>", "Timeout", undefined, { kind: "duration" })
+    .option("--ratio <x>", "Ratio", undefined, { kind: "float" })
+    .option("--mode <mode>", "Mode", "slow", { choices: ["slow", "fast"] })
+    .option("--tags <list>", "Tags", undefined, { kind: "list" });
+
+  // The words Go writes for this command line (see src/go/result.go)
+  const argv = ["-v", "-v", "--timeout", "1500ms", "--ratio", "0.25", "--mode", "fast", "--tags", "a,b"];
+  const NONE = 0xffffffff;
+  const words = new Uint32Array([
+    0, 30, NONE, 0, 6, 0,
+    0, NONE, 0, NONE, 1, 3, 2, 5, 3, 7, 4, 9,
+    2, 0, 2, 0, 1500000000, 0, 0, 0x3fd00000, 1, 0, 0, 0
+  ]);
+  const options = new ParseResult(typedCmd, argv, words).options;
+  const expected = { verbose: 2, timeout: 1500, ratio: 0.25, mode: "fast", tags: ["a", "b"] };
+  if (!require("util").isDeepStrictEqual(options, expected)) {
+    console.log("  ✗ Unexpected typed values:", options, "\n");
+    process.exit(1);
+  }
+  console.log("  Options:", options);
+  console.log("  ✓ Typed option values decoded\n");
+
+  // Defaults read back converted, like the same values given on the command line
+  const defaultsCmd = new Command("defaults-test")
+    .option("--timeout <duration>", "Timeout", "1m30s", { kind: "duration" })
+    .option("--limit <size>", "Limit", "2KiB", { kind: "bytes" })
+    .option("--mode <mode>", "Mode", "fast", { choices: ["slow", "fast"] })
+    .option("--jobs <n>", "Jobs", "0x10", { kind: "int" })
+    .option("--tags <list>", "Tags", "a,b", { kind: "list" })
+    .option("--gzip", "Compress", "true", { kind: "bool" })
+    .option("--retries <n>", "Retries", "many", { kind: "int" });
+  const defaulted = new ParseResult(defaultsCmd, [], new Uint32Array([0, 6, NONE, 0, 0, 0]));
+  const expectedDefaults = { timeout: 90000, limit: 2048, mode: "fast", jobs: 16, tags: ["a", "b"], gzip: true };
+  if (!require("util").isDeepStrictEqual(defaulted.options, expectedDefaults) ||
+      defaulted.get("timeout") !== 90000 || defaulted.get("retries") !== undefined) {
+    console.log("  ✗ Unexpected defaults:", defaulted.options, "\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Defaults converted to their kinds\n");
+
+  // A value-less option whose kind needs a value, given bare in a cluster
+  const bareCmd = new Command("bare-test")
+    .option("-q, --quiet", "Quiet")
+    .option("-l, --level", "Level", undefined, { kind: "int" });
+  const bare = new ParseResult(bareCmd, ["-ql", "x"], new Uint32Array([4, 6, 0, 0, 1, 0]));
+  if (bare.message !== "option '-l' argument '' is invalid") {
+    console.log("  ✗ Unexpected bare option error:", bare.message, "\n");
+    process.exit(1);
+  }
+
+  // A choice error: option slot 3 (--mode), suggestion "fast" (position 1)
+  const miss = new ParseResult(typedCmd, ["--mode", "fsat"], new Uint32Array([5, 6, 0, 0, 3, 2]));
+  const message = "option '--mode' argument 'fsat' is not an allowed choice, did you mean 'fast'?";
+  if (miss.message !== message) {
+    console.log("  ✗ Unexpected choice error:", miss.message, "\n");
+    process.exit(1);
+  }
+  console.log("  Choice error:", miss.message);
+  console.log("  ✓ Choice suggestions decoded\n");
+
+  const withText = (head, text) => {
+    const bytes = Buffer.alloc(Math.ceil(Buffer.byteLength(text) / 4) * 4);
+    bytes.write(text);
+    return new Uint32Array([...head, ...new Uint32Array(bytes.buffer, bytes.byteOffset, bytes.length / 4)]);
+  };
+
+  // --host given through its environment variable: Go sends the text it
+  // read, which process.env need not agree with (see TestHostEnv and
+  // TestEnvInvalidValue in src/go/env_test.go)
+  const FROM_ENV = 0xfffffffe;
+  process.env.GOMMANDER_TEST_HOST = "changed.example.com";
+  const envCmd = new Command("env-test")
+    .option("--host <host>", "Host", "localhost", { env: "GOMMANDER_TEST_HOST" })
+    .option("-p, --port <n>", "Port", 80, { kind: "int", env: "GOMMANDER_TEST_PORT" });
+  const fromEnv = new ParseResult(envCmd, [], withText([0, 13, NONE, 0, 1, 0, 0, FROM_ENV, 10, 11], "example.com"));
+  if (fromEnv.get("host") !== "example.com" || fromEnv.options.host !== "example.com") {
+    console.log("  ✗ Unexpected environment value:", fromEnv.get("host"), "\n");
+    process.exit(1);
+  }
+  // Only the variables of commands the arguments can select are sent
+  envCmd.command("deploy").option("--region <r>", "Region", undefined, { env: "GOMMANDER_TEST_REGION" });
+  envCmd.command("status").option("--since <t>", "Since", undefined, { env: "GOMMANDER_TEST_SINCE" });
+  process.env.GOMMANDER_TEST_REGION = "eu";
+  process.env.GOMMANDER_TEST_SINCE = "1h";
+  envCmd._treeEnv = envCmd._collectEnvVars();
+  const sent = envCmd._environ(["--host", "status", "deploy"]);
+  if (!require("util").isDeepStrictEqual(sent, [
+    "GOMMANDER_TEST_HOST=changed.example.com", "GOMMANDER_TEST_SINCE=1h", "GOMMANDER_TEST_REGION=eu"
+  ]) || envCmd._environ(["deploy"]).some((entry) => entry.startsWith("GOMMANDER_TEST_SINCE="))) {
+    console.log("  ✗ Unexpected environment sent:", sent, "\n");
+    process.exit(1);
+  }
+  const badEnv = new ParseResult(envCmd, [], withText([4, 8, FROM_ENV, 0, 1, 0], "eighty"));
+  const envMessage = "option '--port' argument 'eighty' is invalid (from environment variable GOMMANDER_TEST_PORT)";
+  if (badEnv.message !== envMessage || badEnv.errorIndex !== -1) {
+    console.log("  ✗ Unexpected environment error:", badEnv.message, "\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Environment values decoded\n");
+
+  // Values from the config file: strings follow the values section (see
+  // TestEncodeConfigValues and TestConfigErrors in src/go/config_test.go)
+  const FROM_CONFIG = 0xfffffffd;
+  const configCmd = new Command("config-test")
+    .option("--host <host>", "Host", "localhost")
+    .option("-p, --port <n>", "Port", 80, { kind: "int" })
+    .option("--tags <tag>", "Tags", undefined, { kind: "stringList" });
+  const fromConfig = new ParseResult(configCmd, [], withText([
+    0, 20, NONE, 0, 3, 0,
+    0, FROM_CONFIG, 1, FROM_CONFIG, 2, FROM_CONFIG,
+    18, 3, 7000, 0, 19, 4
+  ], "db1\0a\0bc"));
+  const configOptions = { host: "db1", port: 7000, tags: ["a", "bc"] };
+  if (!require("util").isDeepStrictEqual(fromConfig.options, configOptions)) {
+    console.log("  ✗ Unexpected config values:", fromConfig.options, "\n");
+    process.exit(1);
+  }
+  const badConfig = new ParseResult(configCmd, [], withText([4, 8, FROM_CONFIG, 0, 1, 0], "eighty"));
+  const configMessage = "option '--port' argument 'eighty' is invalid (from config key port)";
+  if (badConfig.message !== configMessage || badConfig.errorIndex !== -1) {
+    console.log("  ✗ Unexpected config error:", badConfig.message, "\n");
+    process.exit(1);
+  }
+  // An unreadable file carries Go's reason after the path
+  configCmd.configFile("app.json");
+  const brokenConfig = new ParseResult(configCmd, [], withText([7, 10, NONE, 0, 0, 0], "unexpected EOF"));
+  if (brokenConfig.message !== "cannot read config file 'app.json': unexpected EOF") {
+    console.log("  ✗ Unexpected config file error:", brokenConfig.message, "\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Config file values decoded\n");
+
+  // Arguments from a response file are numbered from argv.length (see
+  // TestEncodeResponseFileArgs in src/go/responsefile_test.go)
+  const rspCmd = new Command("build")
+    .option("-j, --jobs <n>", "Jobs", undefined, { kind: "int" })
+    .argument("[files...]", "Files");
+  const text = (s) => [...withText([], s)];
+  const rspWords = new Uint32Array([
+    0, 22, NONE, 0, 1, 2,
+    0, 3,
+    0, 4,
+    4, 0,
+    ...text("4"), ...text("b c.c"),
+    3, 12, 1, 4, 13, 5, 2
+  ]);
+  const fromFile = new ParseResult(rspCmd, ["a.c", "@args.rsp"], rspWords);
+  if (fromFile.get("jobs") !== 4 || !require("util").isDeepStrictEqual(fromFile.args, ["a.c", "b c.c"])) {
+    console.log("  ✗ Unexpected response file arguments:", fromFile.args, fromFile.get("jobs"), "\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Response file arguments decoded\n");
+
+  // Values given inline start past their flag (see TestEncodeInlineValues
+  // in src/go/tokens_test.go)
+  const tarCmd = new Command("tar")
+    .option("-x, --extract", "Extract")
+    .option("-v, --verbose", "Verbosity", undefined, { kind: "count" })
+    .option("-f, --file <archive>", "Archive")
+    .option("-j, --jobs <n>", "Jobs", undefined, { kind: "int" })
+    .option("--gzip", "Compress", undefined, { kind: "bool" });
+  const inline = new ParseResult(tarCmd, ["-xvfa.tar", "--jobs=4", "--file=b.tar"], new Uint32Array([
+    0, 26, NONE, 0, 5, 0,
+    0, NONE, 1, NONE, 2, 0, 3, 1, 2, 2,
+    1, 0, 1, 0, 4, 0, 4, 0, 7, 0
+  ]));
+  const inlineOptions = { extract: true, verbose: 1, file: "b.tar", jobs: 4 };
+  if (!require("util").isDeepStrictEqual(inline.options, inlineOptions)) {
+    console.log("  ✗ Unexpected inline values:", inline.options, "\n");
+    process.exit(1);
+  }
+  const inlineError = new ParseResult(tarCmd, ["-vjmany"], new Uint32Array([4, 6, 0, 0, 3, 0]));
+  if (inlineError.message !== "option '-j' argument 'many' is invalid") {
+    console.log("  ✗ Unexpected inline error:", inlineError.message, "\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Inline values decoded\n");
+}
+
+// Test 9: Library-mode outcomes
+console.log("Test 9: Library-mode outcomes");
+{
+  const { ParseResult } = require("../lib/result");
+
+  // Help asked for on a subcommand comes back as a status with the path
+  // and flag index (see TestEncodeRequests in src/go/outcome_test.go)
+  const app = new Command("app");
+  const serve = app.command("serve").option("-p, --port <number>", "Port");
+  const help = new ParseResult(app, ["serve", "-p", "80", "--help"], new Uint32Array([102, 7, 3, 1, 0, 0, 0]));
+  const outcome = help.outcome;
+  if (outcome.kind !== "help" || outcome.command !== serve || outcome.index !== 3) {
+    console.log("  ✗ Unexpected help outcome:", outcome.kind, outcome.index, "\n");
+    process.exit(1);
+  }
+  const quiet = new Command("quiet").version("1.0.0");
+  if (quiet.run(["--version"]).kind !== "version" || quiet.run(["-h"]).kind !== "help") {
+    console.log("  ✗ run() did not report the built-in flags\n");
+    process.exit(1);
+  }
+  const subHelp = app.run(["serve", "--help"]);
+  if (subHelp.kind !== "help" || subHelp.command !== serve) {
+    console.log("  ✗ run() did not report help for the subcommand\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Help and version reported without exiting\n");
+}
+
+// Test 10: Parsing from inside an action
+console.log("Test 10: Parsing from inside an action");
+{
+  // The outer parse is still inside the engine while its action parses
+  // again; each must decode its own arguments and options
+  const seen = [];
+  const shell = new Command("shell");
+  shell.command("exec")
+    .option("-n, --name <name>", "Name")
+    .argument("<line>", "Command line")
+    .action((args, options) => {
+      seen.push(`${options.name}:${args[0]}`);
+      if (args[0] === "outer") {
+        shell.parse(["node", "shell", "exec", "--name", "in", "inner"]);
+      }
+      seen.push(`${options.name}:${args[0]}`);
+    });
+  shell.parse(["node", "shell", "exec", "--name", "out", "outer"]);
+  const expected = "out:outer,in:inner,in:inner,out:outer";
+  if (seen.join(",") !== expected) {
+    console.log("  ✗ Nested parses interfered:", seen.join(","), "\n");
+    process.exit(1);
+  }
+  console.log("  ✓ Nested parses kept their own results\n");
+}
+
 console.log("=== All advanced tests completed successfully! ===");
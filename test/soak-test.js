@@ -0,0 +1,63 @@
+const { Command, addon } = require("../index.js");
+
+// Builds, parses and disposes commands in a loop, the way a long-running
+// router creating per-tenant CLIs would, and checks that RSS stays flat.
+// A second run drops the commands without dispose(), leaving their Go
+// trees to the finalizer.
+// Usage: node --expose-gc test/soak-test.js [cycles]
+
+const cycles = Number(process.argv[2]) || 1000000;
+// The first half lets the V8 and Go heaps settle at their working size
+const warmup = Math.floor(cycles / 2);
+const maxGrowthMB = 16;
+
+function cycle(i, sink, dispose) {
+  const app = new Command(`tenant-${i}`);
+  app.option("-r, --region <region>", "Region", "eu");
+  app.command("deploy", "Deploy a service")
+    .option("-f, --force", "Skip checks")
+    .argument("<service>", "Service name")
+    .action((args) => sink.push(args[0]));
+  app.parse(["node", "app", "deploy", "--force", `svc-${i}`]);
+  if (dispose) app.dispose();
+}
+
+function rssMB() {
+  if (global.gc) global.gc();
+  return process.memoryUsage().rss / 1024 / 1024;
+}
+
+console.log("=== soak test ===\n");
+console.log("Backend:", addon.version());
+if (!global.gc) {
+  console.log("(run with --expose-gc for steadier numbers)");
+}
+
+function soak(label, dispose) {
+  let sink = [];
+  for (let i = 0; i < warmup; i++) {
+    cycle(i, sink, dispose);
+  }
+  sink = [];
+  const baseline = rssMB();
+
+  const start = process.hrtime.bigint();
+  for (let i = warmup; i < cycles; i++) {
+    cycle(i, sink, dispose);
+    if (sink.length >= 10000) sink = [];
+  }
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+  const final = rssMB();
+  const growth = final - baseline;
+
+  console.log(`${label}:`);
+  console.log(`  cycles:   ${cycles} (${Math.round((cycles - warmup) / seconds)}/s)`);
+  console.log(`  rss:      ${baseline.toFixed(1)} MB -> ${final.toFixed(1)} MB`);
+  const ok = growth < maxGrowthMB;
+  console.log(`  growth:   ${ok ? "✓" : "✗"} ${growth.toFixed(1)} MB (limit ${maxGrowthMB} MB)`);
+  if (!ok) process.exitCode = 1;
+}
+
+soak("dispose()", true);
+soak("finalizer only", false);
+console.log("\n=== soak test completed ===");
@@ -0,0 +1,65 @@
+const { Worker, isMainThread, parentPort, workerData } = require("worker_threads");
+
+// Each worker_thread loads the addon into its own environment with its own
+// Go registry; workers starting and exiting must not disturb each other or
+// the main thread.
+
+function buildCli(Command, results) {
+  const app = new Command("pool");
+  app.command("run", "Run a job")
+    .option("-n, --name <name>", "Job name")
+    .option("-v, --verbose", "Verbose output")
+    .argument("<input>", "Input file")
+    .action((args, options) => results.push(`${options.name}:${args[0]}`));
+  return app;
+}
+
+if (!isMainThread) {
+  const { Command } = require("../index.js");
+  const results = [];
+  const app = buildCli(Command, results);
+  for (let i = 0; i < workerData.rounds; i++) {
+    app.parse(["node", "pool", "run", "--name", `w${workerData.id}`, `file-${i}`]);
+  }
+  parentPort.postMessage(results);
+  return;
+}
+
+const { Command, addon } = require("../index.js");
+
+console.log("=== worker_threads test ===\n");
+console.log("Backend:", addon.version());
+
+const mainResults = [];
+const mainCli = buildCli(Command, mainResults);
+mainCli.parse(["node", "pool", "run", "--name", "main", "before"]);
+
+const workers = 4;
+const rounds = 200;
+const runs = [];
+for (let id = 0; id < workers; id++) {
+  runs.push(new Promise((resolve, reject) => {
+    const worker = new Worker(__filename, { workerData: { id, rounds } });
+    worker.once("message", resolve);
+    worker.once("error", reject);
+  }));
+}
+
+Promise.all(runs).then((results) => {
+  results.forEach((lines, id) => {
+    const ok = lines.length === rounds && lines.every((line, i) => line === `w${id}:file-${i}`);
+    console.log(`  worker ${id}: ${ok ? "✓" : "✗"} ${lines.length} parses`);
+    if (!ok) process.exitCode = 1;
+  });
+
+  // The main thread's commands survive workers loading and unloading
+  mainCli.parse(["node", "pool", "run", "--name", "main", "after"]);
+  const ok = mainResults.join(",") === "main:before,main:after";
+  console.log(`  main thread: ${ok ? "✓" : "✗"} ${mainResults.join(", ")}`);
+  if (!ok) process.exitCode = 1;
+
+  console.log("\n=== worker_threads test completed ===");
+}).catch((error) => {
+  console.log("✗ Worker error:", error.message);
+  process.exitCode = 1;
+});